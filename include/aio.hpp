@@ -0,0 +1,445 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * aio.hpp
+ *
+ * Awaitable file I/O for coroutines. open, statx, read and close go through
+ * io_uring when the kernel offers it and through the pool otherwise;
+ * getdents always runs on the pool, io_uring has no opcode for it. Results
+ * are raw syscall results, negative values are -errno.
+ *
+ * A coroutine is resumed on the kind of thread it suspended on: coroutines
+ * suspended on the main thread continue in dispatch(), which the main loop
+ * calls whenever event_fd() becomes readable, all others continue on the pool.
+*/
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include <string>
+#include <vector>
+
+#include <atomic>
+#include <functional>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "pool.hpp"
+
+#define AIO_QUEUE_DEPTH 256
+
+namespace cliex
+{
+namespace aio
+{
+template <typename T> class task;
+
+namespace detail
+{
+// one outstanding operation; a batch completes once all its requests did
+struct completion
+{
+    std::coroutine_handle<> handle;
+    bool on_main = false;
+    std::atomic<size_t> remaining{1};
+};
+
+// where io_uring writes a single result
+struct request
+{
+    completion *parent;
+    int res;
+};
+
+void suspend(completion&, std::coroutine_handle<>, size_t = 1);
+void complete(completion&);
+
+void open(request&, const std::string&, int);
+void statx(request&, int, const std::string&, struct statx*);
+void read(request&, int, void*, unsigned, off_t);
+void close(request&, int);
+void getdents(request&, int, void*, unsigned);
+
+struct promise_base
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    struct final_awaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            auto next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept
+        {
+        }
+    };
+
+    final_awaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        error = std::current_exception();
+    }
+};
+
+template <typename T>
+struct promise : promise_base
+{
+    std::optional<T> value;
+
+    task<T> get_return_object();
+
+    void return_value(T v)
+    {
+        value = std::move(v);
+    }
+
+    T result()
+    {
+        if (error)
+            std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct promise<void> : promise_base
+{
+    task<void> get_return_object();
+
+    void return_void()
+    {
+    }
+
+    void result()
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+}
+
+/*
+ * A lazy coroutine: it starts when it is awaited or spawned and resumes its
+ * awaiter when it returns.
+*/
+template <typename T = void>
+class task
+{
+public:
+    using promise_type = detail::promise<T>;
+
+    explicit task(std::coroutine_handle<promise_type> h) : coro(h)
+    {
+    }
+
+    task(task &&other) noexcept : coro(std::exchange(other.coro, {}))
+    {
+    }
+
+    task(const task&) = delete;
+    task &operator=(const task&) = delete;
+
+    ~task()
+    {
+        if (coro)
+            coro.destroy();
+    }
+
+    bool await_ready() const
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter)
+    {
+        coro.promise().continuation = awaiter;
+        return coro;
+    }
+
+    T await_resume()
+    {
+        return coro.promise().result();
+    }
+
+private:
+    std::coroutine_handle<promise_type> coro;
+};
+
+template <typename T>
+task<T> detail::promise<T>::get_return_object()
+{
+    return task<T>{std::coroutine_handle<promise<T>>::from_promise(*this)};
+}
+
+inline task<void> detail::promise<void>::get_return_object()
+{
+    return task<void>{std::coroutine_handle<promise<void>>::from_promise(*this)};
+}
+
+bool init();
+const char *backend();
+int event_fd();
+
+// runs the completions that belong to the main thread, never blocks
+void dispatch();
+// main thread: waits until fd is readable or completions arrived, runs them
+// and returns whether fd is readable
+bool wait(int fd);
+// main thread: runs completions until every spawned task has finished
+void wait_idle();
+// makes wait() return, also safe in signal handlers
+void notify();
+// main thread: wait() runs f whenever fd is readable
+void on_readable(int fd, std::function<void()> f);
+
+// starts a task on the calling thread, it destroys itself when done
+void spawn(task<void>);
+
+template <typename F>
+struct single_op
+{
+    F start;
+    detail::completion done;
+    detail::request req{&done, 0};
+
+    bool await_ready() const
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        detail::suspend(done, h);
+        start(req);
+    }
+
+    int await_resume() const
+    {
+        return req.res;
+    }
+};
+
+template <typename F>
+single_op<F> make_op(F f)
+{
+    return single_op<F>{std::move(f), {}};
+}
+
+inline auto open(const std::string &path, int flags)
+{
+    return make_op([&path, flags](detail::request &r)
+    {
+        detail::open(r, path, flags);
+    });
+}
+
+inline auto read(int fd, void *buf, unsigned len, off_t offset)
+{
+    return make_op([=](detail::request &r)
+    {
+        detail::read(r, fd, buf, len, offset);
+    });
+}
+
+inline auto close(int fd)
+{
+    return make_op([=](detail::request &r)
+    {
+        detail::close(r, fd);
+    });
+}
+
+inline auto getdents(int fd, void *buf, unsigned len)
+{
+    return make_op([=](detail::request &r)
+    {
+        detail::getdents(r, fd, buf, len);
+    });
+}
+
+inline auto statx(int dirfd, const std::string &path, struct statx *out)
+{
+    return make_op([dirfd, &path, out](detail::request &r)
+    {
+        detail::statx(r, dirfd, path, out);
+    });
+}
+
+/*
+ * statx for many names relative to one directory, submitted at once. The
+ * result holds one syscall result per name.
+*/
+struct statx_batch
+{
+    int dirfd;
+    const std::vector<std::string> &names;
+    std::vector<struct statx> &out;
+    detail::completion done;
+    std::vector<detail::request> reqs;
+
+    bool await_ready() const
+    {
+        return names.empty();
+    }
+
+    void await_suspend(std::coroutine_handle<>);
+
+    std::vector<int> await_resume() const;
+};
+
+inline statx_batch statx_all(int dirfd, const std::vector<std::string> &names, std::vector<struct statx> &out)
+{
+    return statx_batch{dirfd, names, out, {}, {}};
+}
+
+// runs f on the pool, for work that has no asynchronous form
+template <typename F>
+struct offload_op
+{
+    using result_type = decltype(std::declval<F&>()());
+
+    F f;
+    priority prio;
+    detail::completion done;
+    std::optional<std::conditional_t<std::is_void_v<result_type>, bool, result_type>> value;
+    std::exception_ptr error;
+
+    bool await_ready() const
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        detail::suspend(done, h);
+        pool::submit([this]
+        {
+            try
+            {
+                if constexpr (std::is_void_v<result_type>)
+                {
+                    f();
+                    value = true;
+                }
+                else
+                {
+                    value = f();
+                }
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            detail::complete(done);
+        }, prio);
+    }
+
+    result_type await_resume()
+    {
+        if (error)
+            std::rethrow_exception(error);
+        if constexpr (!std::is_void_v<result_type>)
+            return std::move(*value);
+    }
+};
+
+template <typename F>
+offload_op<F> offload(F f, priority p = PRIORITY_VISIBLE)
+{
+    return offload_op<F>{std::move(f), p, {}, {}, {}};
+}
+
+// runs f(i) for every i below count on the pool at once, for work that
+// splits into independent parts; the first exception is rethrown
+template <typename F>
+struct parallel_op
+{
+    F f;
+    size_t count;
+    priority prio;
+    detail::completion done;
+    std::vector<std::exception_ptr> errors;
+
+    bool await_ready() const
+    {
+        return count == 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        errors.resize(count);
+        detail::suspend(done, h, count);
+        for (size_t i = 0; i < count; i++)
+        {
+            pool::submit([this, i]
+            {
+                try
+                {
+                    f(i);
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                }
+                detail::complete(done);
+            }, prio);
+        }
+    }
+
+    void await_resume()
+    {
+        for (const auto &e : errors)
+        {
+            if (e)
+                std::rethrow_exception(e);
+        }
+    }
+};
+
+template <typename F>
+parallel_op<F> parallel(size_t count, F f, priority p = PRIORITY_VISIBLE)
+{
+    return parallel_op<F>{std::move(f), count, p, {}, {}};
+}
+}
+}
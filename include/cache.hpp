@@ -0,0 +1,67 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * cache.hpp
+ *
+ * The listings of the process, shared by every tab. A directory is listed
+ * once and the listing is kept current with one inotify watch, so showing it
+ * again, in any tab, costs nothing. Listings no tab shows anymore are dropped
+ * oldest first once there are more than CACHE_MAX_LISTINGS. A directory
+ * that can't be watched (not the local filesystem, NFS, out of watches) is
+ * listed again when it's asked for after CACHE_UNWATCHED_TTL_MS.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <memory>
+#include <functional>
+
+#include <experimental/filesystem>
+
+#include "cliex.hpp"
+
+#define CACHE_MAX_LISTINGS 32
+#define CACHE_UNWATCHED_TTL_MS 2000
+// room for this many inotify events of the longest name per read
+#define CACHE_EVENT_BATCH 16
+
+namespace fs = std::experimental::filesystem;
+
+namespace cliex
+{
+namespace cache
+{
+// the listing of dir; one that isn't cached yet loads in the background
+std::shared_ptr<listing> get(const fs::path&, const std::vector<std::string>&);
+// the same for a listing that may not be needed, see cancel()
+std::shared_ptr<listing> prefetch(const fs::path&, const std::vector<std::string>&);
+// stops loading a listing that get() hasn't asked for since it was prefetched
+void cancel(const std::shared_ptr<listing>&);
+
+// how many listings are kept, CACHE_MAX_LISTINGS unless set
+void limit(size_t);
+
+// called on the main thread after an entry was inserted into or erased from
+// a listing that is done, with the index of that entry
+void on_change(std::function<void(const listing&, size_t, bool inserted)>);
+}
+}
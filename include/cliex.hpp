@@ -22,16 +22,24 @@
  * Declarations of all functions used in the main.cpp file
 */
 
+#pragma once
+
 #include <string>
 
 #include <vector>
 #include <map>
+#include <memory>
 
 #include <experimental/filesystem>
 
-#include <menu.h>
 #include <ncurses.h>
 
+#include "stats.hpp"
+#include "aio.hpp"
+#include "pool.hpp"
+#include "grid.hpp"
+#include "timestamp.hpp"
+
 namespace fs = std::experimental::filesystem;
 
 #define ROOT_DIR "/"
@@ -47,6 +55,48 @@ namespace fs = std::experimental::filesystem;
 
 #define INDEX_ARG_HIDDEN_FILES 0
 #define INDEX_ARG_MAX_COLUMNS 1
+#define INDEX_ARG_STATS 2
+#define INDEX_ARG_DEBUG_OVERLAY 3
+#define INDEX_ARG_SCRIPT 4
+#define INDEX_ARG_VFS 5
+#define INDEX_ARG_SYNTHETIC 6
+#define INDEX_ARG_VFS_LATENCY 7
+#define INDEX_ARG_VFS_JITTER 8
+#define INDEX_ARG_VFS_FAILURES 9
+#define INDEX_ARG_RSS_BUDGET 10
+#define INDEX_ARG_PERF 11
+#define INDEX_ARG_PROFILE 12
+#define INDEX_ARG_SYNC_OUTPUT 13
+#define INDEX_ARG_MILLER 14
+#define INDEX_ARG_TREE 15
+#define INDEX_ARG_LIST 16
+#define INDEX_ARG_FORMAT 17
+#define INDEX_ARG_RECURSIVE 18
+#define INDEX_ARG_SORT 19
+#define INDEX_ARG_DAEMON 20
+#define INDEX_ARG_DAEMON_SOCKET 21
+#define INDEX_ARG_USE_DAEMON 22
+#define INDEX_ARG_SHARED_CACHE 23
+#define INDEX_ARG_GIT_STATUS 24
+#define INDEX_ARG_HIDE_IGNORED 25
+#define INDEX_ARG_TYPE 26
+#define INDEX_ARG_NAME 27
+#define INDEX_ARG_MIN_SIZE 28
+#define INDEX_ARG_MAX_SIZE 29
+#define INDEX_ARG_NEWER 30
+#define INDEX_ARG_OLDER 31
+#define INDEX_ARG_TIME_STYLE 32
+#define INDEX_ARG_COUNT 33
+
+#define DEFAULT_SYNTHETIC_ENTRIES 1000
+
+#define DEBUG_OVERLAY_Y 10
+#define LOADING_WIDTH 12
+#define TAB_BAR_X 21
+#define TAB_LABEL_WIDTH 16
+
+// buffer for one getdents call
+#define DIRENT_BUFFER_SIZE (64 * 1024)
 
 extern const char *home_dir;
 
@@ -55,16 +105,49 @@ extern std::vector<std::string> split(const std::string&);
 
 namespace cliex
 {
+class tree_view;
+class query;
+
 std::map<std::string, std::string> get_all_types();
 std::string get_type(fs::path, fs::perms, std::map<std::string, std::string>&);
+// the same for a status and symlink status the caller already has
+std::string get_type(fs::path, fs::file_status, fs::file_status, std::map<std::string, std::string>&);
 std::string get_perms(fs::perms);
 std::map<std::string, std::string> load_config(std::string);
 
-void get_dir_content(const char *, std::vector<std::string>&, fs::path, std::vector<std::string>&);
+void get_dir_content(const char *, std::vector<std::string>&, fs::path, std::vector<std::string>&, const cancel_token& = {});
+
+// byte order, but ".." comes first
+bool entry_less(const std::string&, const std::string&);
+
+// a listing that is loaded in the background, entries are in entry_less order
+struct listing
+{
+    fs::path dir;
+    std::vector<std::string> entries;
+    std::vector<unsigned short> widths;
+    std::string error;
+    bool done = false;
+    // loaded ahead of need, at a lower priority and until cancelled
+    bool speculative = false;
+    cancel_token cancel;
+    // the directory that was read, 0 if unknown; its path may lead
+    // somewhere else by now
+    dev_t dev = 0;
+    ino_t ino = 0;
+};
+
+aio::task<void> load_listing(std::shared_ptr<listing>, std::vector<std::string>);
+// a listing of the entries of another one that match, filled in the background
+std::shared_ptr<listing> query_listing(std::shared_ptr<const listing>, std::shared_ptr<const query>);
 
 WINDOW *add_win(int, int, int, int, const char *);
-MENU *add_file_menu(WINDOW*, std::vector<std::string>&, std::vector<ITEM *>&, fs::path, std::vector<std::string>&);
-void clear_menu(MENU*, std::vector<ITEM *>&);
-void show_file_info(WINDOW*, std::string&, fs::path, std::map<std::string, std::string>&);
+void show_dir(WINDOW*, file_grid&, std::vector<std::string>&, std::vector<unsigned short>&, fs::path, std::vector<std::string>&);
+void show_tree(WINDOW*, tree_view&, std::shared_ptr<listing>);
+void reflow(WINDOW*, file_grid&, fs::path);
+void reflow(WINDOW*, tree_view&, fs::path);
+void show_file_info(WINDOW*, std::string&, fs::path, std::map<std::string, std::string>&, timestamp::style);
+void show_error(WINDOW*, const std::string&);
+stats::footprint get_footprint(std::vector<std::string>&, std::vector<unsigned short>&, file_grid&, std::map<std::string, std::string>&);
 
 }
\ No newline at end of file
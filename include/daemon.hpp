@@ -0,0 +1,65 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * daemon.hpp
+ *
+ * cliex --daemon (or cliex run as cliexd) serves directory listings to every
+ * explorer on the machine over a Unix socket, from one cache that inotify
+ * keeps current, so a directory is read once however many explorers show
+ * it. Explorers ask the daemon first and read the directory themselves when
+ * there is none or it can't answer.
+ *
+ * A request carries an open descriptor of the directory: only a client that
+ * could read the directory itself gets its listing. Clients in turn only
+ * trust a daemon run by root or by their own user.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <experimental/filesystem>
+
+#define DAEMON_SOCKET "/tmp/cliexd.sock"
+#define DAEMON_MAX_LISTINGS 4096
+// a client gives up on an answer after this long and reads the directory itself
+#define DAEMON_TIMEOUT_MS 10000
+// and doesn't try to connect again for this long after a failed attempt
+#define DAEMON_RETRY_MS 10000
+#define DAEMON_MAX_REPLY (512 << 20)
+
+namespace fs = std::experimental::filesystem;
+
+namespace cliex
+{
+namespace daemon
+{
+// serves until SIGINT or SIGTERM, returns the exit status
+int serve(const std::string&);
+
+// lets listings of the local filesystem come from the daemon at this socket
+void use(const std::string&);
+// whether fetch() is worth a try right now
+bool available();
+// blocks; the entries of dir in entry_less order, false if the daemon
+// didn't answer
+bool fetch(const fs::path&, std::vector<std::string>&);
+}
+}
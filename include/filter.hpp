@@ -0,0 +1,113 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * filter.hpp
+ *
+ * Which entries a listing keeps, decided while the directory is read. The
+ * name and the type getdents reports are checked before anything is
+ * allocated for an entry, and only entries that pass them and still need
+ * their size or modification time cost a stat.
+ *
+ * by_name keeps directories whenever their type is wanted, whatever their
+ * name, so the explorer can still navigate a filtered tree and it can still
+ * be walked; by_meta applies every predicate to them.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <limits.h>
+#include <dirent.h>
+
+#include <experimental/filesystem>
+
+#include "glob.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+namespace cliex
+{
+enum filter_kind
+{
+    FILTER_FILE = 1,
+    FILTER_DIR = 2,
+    FILTER_LINK = 4,
+    FILTER_OTHER = 8,
+    FILTER_ALL = 15
+};
+
+enum filter_verdict
+{
+    FILTER_KEEP,
+    // not shown, a directory may still be walked
+    FILTER_SKIP,
+    // not shown, not walked
+    FILTER_DROP,
+    // the name passed, the rest needs a stat
+    FILTER_STAT
+};
+
+class entry_filter
+{
+public:
+    entry_filter() = default;
+    // from --show_hidden, --type, --name, --min_size, --max_size, --newer
+    // and --older; throws std::invalid_argument for malformed values
+    explicit entry_filter(const std::vector<std::string>&);
+
+    // whether it drops anything but hidden entries
+    bool active() const;
+    bool keeps_all() const
+    {
+        return hidden && !active();
+    }
+
+    // d_type as getdents reports it, DT_UNKNOWN if it didn't
+    filter_verdict by_name(const char*, unsigned char) const;
+    // every predicate; the type is the entry's own, size and mtime may be
+    // those of a link's target
+    bool by_meta(const char*, fs::file_type, unsigned long long, long long) const;
+    // by_meta for an entry of the vfs whose status is known, directories
+    // are kept like by_name keeps them
+    bool by_status(const fs::path&, const fs::file_status&) const;
+    // whether by_meta looks at the size and the modification time
+    bool needs_meta() const
+    {
+        return min_size >= 0 || max_size >= 0 || newer != LLONG_MIN || older != LLONG_MAX;
+    }
+
+private:
+    bool hidden = true;
+    unsigned kinds = FILTER_ALL;
+    bool named = false;
+    glob name;
+    long long min_size = -1;
+    long long max_size = -1;
+    long long newer = LLONG_MIN;
+    long long older = LLONG_MAX;
+};
+
+// 10, 4K, 1.5M or 2G, in bytes
+long long parse_size(const std::string&);
+// 30s, 15m, 12h, 7d or 2w, in seconds
+long long parse_age(const std::string&);
+}
@@ -0,0 +1,50 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * frame.hpp
+ *
+ * Windows are not refreshed one by one. Whatever changes a window calls
+ * touch(), and the main loop calls present() once per frame: all touched
+ * windows are staged with wnoutrefresh and sent to the terminal with a
+ * single doupdate. On terminals that support it, the frame is wrapped in
+ * synchronized output, so it's shown all at once.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <ncurses.h>
+
+namespace cliex
+{
+namespace frame
+{
+// sync is "true", "false" or empty to ask terminfo
+void init(int, const std::string&);
+bool synchronized();
+
+void touch(WINDOW*);
+// a window is about to be deleted, it's dropped from the frame
+void forget(WINDOW*);
+void present();
+
+unsigned long frames();
+}
+}
@@ -0,0 +1,63 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * git.hpp
+ *
+ * git status marks for the entries of directories in a repository, like the
+ * first column of git status --short. They come from .git/index, whose
+ * cached stat data is compared with the files the same way git's fast path
+ * does it; git itself isn't run. A file whose stat data differs is marked
+ * modified without comparing its content, one whose stat data matches but
+ * isn't older than the index is marked unknown.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <experimental/filesystem>
+
+#include "cliex.hpp"
+
+#define GIT_MARK_MODIFIED 'M'
+#define GIT_MARK_UNMERGED 'U'
+#define GIT_MARK_UNTRACKED '?'
+#define GIT_MARK_IGNORED '!'
+// stat data written no earlier than the index itself, see racy git
+#define GIT_MARK_UNKNOWN '~'
+#define GIT_MARK_WIDTH 2
+// directories whose marks are kept
+#define GIT_MAX_DIRS 64
+
+namespace fs = std::experimental::filesystem;
+
+namespace cliex
+{
+namespace git
+{
+// recomputes the marks of a listed directory in the background
+void refresh(const listing&);
+// the mark of an entry, ' ' if it's clean, 0 if the directory isn't known
+// to be in a repository yet; a listing without marks is refreshed
+char mark(const listing&, size_t);
+bool repository(const fs::path&);
+// whether marks arrived since the last call
+bool changed();
+}
+}
@@ -0,0 +1,78 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * glob.hpp
+ *
+ * Shell patterns with gitignore's extensions: '*' and '?' don't match '/',
+ * "**" matches across directories, [a-z] and [!a-z] are classes and '\'
+ * quotes the next character. A pattern is compiled once into a sequence of
+ * tokens.
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <bitset>
+
+namespace cliex
+{
+class glob
+{
+public:
+    glob() = default;
+    explicit glob(std::string_view);
+
+    bool match(std::string_view) const;
+
+    // whether a pattern is more than a literal string
+    static bool has_meta(std::string_view);
+
+private:
+    enum op : unsigned char
+    {
+        OP_LITERAL,
+        OP_ANY,
+        OP_CLASS,
+        // anything but '/'
+        OP_STAR,
+        // anything, '/' included
+        OP_GLOBSTAR,
+        // zero or more whole directories, each with its '/'
+        OP_DIRS
+    };
+
+    struct token
+    {
+        token(op kind) : kind(kind)
+        {
+        }
+
+        op kind;
+        bool negate = false;
+        std::string text;
+        std::bitset<256> set;
+    };
+
+    std::vector<token> tokens;
+
+    static bool match(const token*, const token*, std::string_view);
+};
+}
@@ -0,0 +1,145 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * grid.hpp
+ *
+ * The listing, laid out like ls -C: entries run down the first column, then
+ * down the next one, and every column is as wide as its widest entry. The
+ * layout uses the most columns that fit; the grid scrolls by rows.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <limits.h>
+
+#include <ncurses.h>
+
+// columns between two columns
+#define GRID_GAP 2
+// entries summarized by one precomputed maximum
+#define GRID_BLOCK 64
+// if fewer columns fit and the listing doesn't fit on screen, long names
+// are truncated to make room for this many
+#define GRID_MIN_COLUMNS 3
+#define GRID_TRUNCATED '~'
+// a mark in front of every entry and the space after it
+#define GRID_MARK_WIDTH 2
+
+namespace cliex
+{
+/*
+ * Finding the layout only needs the widest entry of each candidate column.
+ * With the maximum of every block of GRID_BLOCK entries at hand, that costs
+ * n / GRID_BLOCK steps per column count instead of n.
+*/
+class grid_layout
+{
+public:
+    void assign(const std::vector<unsigned short>*);
+    // the widths have changed at this index, by an insert or an erase
+    void changed(size_t);
+
+    // every column also holds extra columns in front of its entries
+    void fit(unsigned width, unsigned height, unsigned max_columns, unsigned extra = 0);
+
+    size_t rows() const
+    {
+        return row_count;
+    }
+
+    size_t columns() const
+    {
+        return column_widths.size();
+    }
+
+    unsigned column_width(size_t c) const
+    {
+        return column_widths[c];
+    }
+
+    size_t memory() const;
+
+private:
+    const std::vector<unsigned short> *widths = nullptr;
+    std::vector<unsigned short> block_max;
+    std::vector<unsigned> column_widths;
+    size_t row_count = 0;
+
+    unsigned range_max(size_t, size_t) const;
+    bool try_rows(size_t, unsigned, unsigned, unsigned, std::vector<unsigned>&) const;
+    void search(unsigned, unsigned, unsigned, unsigned);
+};
+
+class file_grid
+{
+public:
+    ~file_grid();
+
+    void place(WINDOW*, int, int, int, int);
+    void close();
+    void assign(const std::vector<std::string>*, const std::vector<unsigned short>*, unsigned);
+    void changed(size_t);
+    // lays the same entries out again after the window was placed anew
+    void reflow();
+    // at most this many columns, whatever assign() was given
+    void limit(unsigned);
+    // draws the mark f returns in front of each entry, f may be empty
+    void marks(std::function<char(size_t)> f);
+
+    void down();
+    void up();
+    void right();
+    void left();
+    void page_down();
+    void page_up();
+    void select(size_t);
+
+    size_t cursor() const
+    {
+        return current;
+    }
+
+    std::string selected() const;
+    WINDOW *window() const
+    {
+        return win;
+    }
+
+    void draw();
+    size_t memory() const;
+
+private:
+    WINDOW *win = nullptr;
+    const std::vector<std::string> *names = nullptr;
+    const std::vector<unsigned short> *widths = nullptr;
+    grid_layout layout;
+    unsigned max_columns = 0;
+    unsigned column_limit = UINT_MAX;
+    std::function<char(size_t)> mark_of;
+    size_t current = 0;
+    size_t top = 0;
+
+    void fit();
+    void move_to(size_t);
+};
+}
@@ -0,0 +1,79 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * ignore.hpp
+ *
+ * .gitignore and .ignore files. The patterns of every ignore file that
+ * applies to a directory are compiled once and kept per directory; a
+ * subdirectory inherits them and only adds its own files. .gitignore files,
+ * the repository's info/exclude and the user's excludes only count inside a
+ * git work tree, .ignore files count everywhere and take precedence.
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+#define IGNORE_MAX_DIRS 4096
+
+namespace cliex
+{
+namespace ignore
+{
+struct layer;
+
+class matcher
+{
+public:
+    // whether an entry of the directory is ignored; names of directories
+    // come without their '/'
+    bool ignored(std::string_view name, bool dir) const;
+    // the same, by git's ignore files only
+    bool git_ignored(std::string_view name, bool dir) const;
+
+    // the matcher of the subdirectory name, whose ignore files are read
+    // through its open descriptor
+    std::shared_ptr<const matcher> child(std::string_view name, int dirfd) const;
+
+private:
+    struct placed
+    {
+        std::shared_ptr<const layer> rules;
+        // the directory, relative to the one the rules come from
+        std::string prefix;
+    };
+
+    // the innermost rules come last
+    std::vector<placed> layers;
+    // the directory itself lies in an ignored directory
+    bool all = false;
+    bool all_git = false;
+
+    bool match(std::string_view, bool, bool) const;
+};
+
+// the matcher of a directory, nullptr if it can't be opened
+std::shared_ptr<const matcher> for_dir(const std::string&);
+// an ignore file has changed, every matcher is built anew
+void forget();
+}
+}
@@ -0,0 +1,69 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * info.hpp
+ *
+ * The metadata of the entry under the cursor, for the file information. A
+ * slow mount would hold up the cursor, so it's read on the pool, with one
+ * lstat on the local filesystem; until it arrives the pane shows
+ * placeholders. What was read is shown while it's read again after
+ * INFO_TTL_MS.
+ *
+ * Only the main thread calls these.
+*/
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <ctime>
+
+#include <experimental/filesystem>
+
+#include "vfs.hpp"
+
+// entries whose metadata is kept
+#define INFO_CACHED 64
+#define INFO_TTL_MS 1000
+
+namespace fs = std::experimental::filesystem;
+
+namespace cliex
+{
+namespace info
+{
+struct details
+{
+    // what a link points to, the link itself if that's missing
+    fs::file_status status;
+    fs::file_status link;
+    std::uintmax_t size = 0;
+    ownership owner = {0, 0};
+    time_t mtime = 0;
+    // why it couldn't be read, empty if it could
+    std::string error;
+};
+
+// the metadata of an entry, nullptr until it was read; reading starts in
+// the background
+const details *get(const fs::path&);
+// whether metadata arrived since the last call
+bool changed();
+}
+}
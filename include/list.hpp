@@ -0,0 +1,43 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * list.hpp
+ *
+ * cliex --list: writes a listing with the type, size, permissions and
+ * modification time of every entry to stdout instead of showing it, so
+ * scripts need one process for a whole tree instead of an ls or stat per
+ * file. The terminal isn't touched.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// output is written in chunks of this size
+#define LIST_BUFFER_SIZE (1 << 20)
+
+namespace cliex
+{
+namespace list
+{
+// returns the exit status
+int run(const std::string&, std::vector<std::string>&);
+}
+}
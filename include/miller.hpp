@@ -0,0 +1,86 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * miller.hpp
+ *
+ * Miller columns, as in ranger: the parent directory on the left, the grid
+ * with the current one in the middle and the directory under the cursor on
+ * the right. The side columns come from the listing cache; what isn't cached
+ * is prefetched, and cancelled as soon as the cursor has moved on.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <experimental/filesystem>
+
+#include <ncurses.h>
+
+#include "cliex.hpp"
+#include "grid.hpp"
+
+// the parent column takes this part of the width, the rest is split evenly
+#define MILLER_PARENT_SHARE 4
+
+namespace fs = std::experimental::filesystem;
+
+namespace cliex
+{
+class miller_view
+{
+public:
+    ~miller_view();
+
+    // the side columns and the grid between them, in this area of the window
+    void place(WINDOW*, file_grid&, int, int, int, int);
+    void close();
+
+    bool active() const
+    {
+        return parent.win != nullptr;
+    }
+
+    // the grid shows dir with the cursor on selected
+    void follow(const fs::path&, const std::string&, const std::vector<std::string>&);
+    // redraws a side column whose listing has finished loading, returns
+    // whether one did
+    bool update();
+    bool shows(const listing&) const;
+    void draw();
+
+private:
+    struct column
+    {
+        WINDOW *win = nullptr;
+        std::shared_ptr<listing> shown;
+        bool drawn_done = false;
+    };
+
+    column parent;
+    column child;
+    fs::path current;
+    std::string under_cursor;
+
+    void show(column&, const fs::path&, const std::vector<std::string>&);
+    void draw(column&, const std::string&, int);
+};
+}
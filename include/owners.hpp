@@ -0,0 +1,47 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+
+/**
+ * owners.hpp
+ *
+ * User and group names for the file information. NSS may have to ask a
+ * directory server, so names are looked up on the pool and kept for a while;
+ * until a name is known its number stands in. A name that has expired keeps
+ * being shown while it's looked up again.
+ *
+ * Only the main thread calls these.
+*/
+
+#pragma once
+
+#include <string>
+
+// seconds until a name is looked up again
+#define OWNERS_TTL 300
+
+namespace cliex
+{
+namespace owners
+{
+std::string user(unsigned);
+std::string group(unsigned);
+// whether names arrived since the last call
+bool changed();
+}
+}
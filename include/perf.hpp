@@ -0,0 +1,61 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * perf.hpp
+ *
+ * Hardware performance counters (perf_event_open) around the hot paths.
+ * Once enabled, every perf::scope adds the cycles, instructions, cache misses
+ * and branch misses of the calling thread to the totals of its operation.
+ * Without permission for the counters, scopes cost a single branch.
+*/
+
+#pragma once
+
+#include <string>
+
+namespace cliex
+{
+namespace perf
+{
+enum counter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNT
+};
+
+bool enable();
+bool enabled();
+std::string dump();
+
+class scope
+{
+public:
+    scope(const char *);
+    ~scope();
+
+private:
+    const char *op;
+    bool active;
+    unsigned long long start[PERF_COUNT];
+};
+}
+}
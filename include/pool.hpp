@@ -0,0 +1,98 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * pool.hpp
+ *
+ * The one place where the explorer creates threads. Background work is
+ * submitted to a fixed set of workers, each with its own deque per priority;
+ * idle workers steal from the others. Work for what is on screen always runs
+ * before prefetching, and prefetching before bulk jobs.
+ *
+ * Tasks that block on I/O take an io_slot first, which caps the number of
+ * concurrent blocking calls independently of the number of workers.
+*/
+
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+
+#define POOL_MAX_WORKERS 8
+#define POOL_MAX_BLOCKING_IO 4
+
+namespace cliex
+{
+enum priority
+{
+    PRIORITY_VISIBLE,
+    PRIORITY_PREFETCH,
+    PRIORITY_BULK,
+    PRIORITY_COUNT
+};
+
+/*
+ * Cooperative cancellation: a task checks cancelled() at convenient points.
+ * Tasks whose token is cancelled before they start are dropped. A default
+ * constructed token can't be cancelled.
+*/
+class cancel_token
+{
+public:
+    static cancel_token create();
+
+    void cancel() const;
+    bool cancelled() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+namespace pool
+{
+void start();
+void stop();
+unsigned size();
+
+void submit(std::function<void()>, priority = PRIORITY_BULK, cancel_token = {});
+
+template <typename F>
+auto async(priority p, F f) -> std::future<decltype(f())>
+{
+    auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+    auto result = task->get_future();
+    submit([task]
+    {
+        (*task)();
+    }, p);
+    return result;
+}
+
+class io_slot
+{
+public:
+    io_slot();
+    ~io_slot();
+
+    io_slot(const io_slot&) = delete;
+    io_slot &operator=(const io_slot&) = delete;
+};
+}
+}
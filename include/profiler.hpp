@@ -0,0 +1,62 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * profiler.hpp
+ *
+ * A sampling profiler for hosts without perf. Every registered thread gets a
+ * CPU-time timer that sends it SIGPROF; the handler walks the frame pointers
+ * and stores the stack. On stop() the stacks are symbolized and written as
+ * folded stacks ("main;foo;bar 42"), ready for flamegraph tools.
+ *
+ * Stacks are only complete in builds that keep frame pointers, see the
+ * profile target of the Makefile.
+*/
+
+#pragma once
+
+#include <string>
+
+#define PROFILER_HZ 999
+#define PROFILER_MAX_DEPTH 48
+#define PROFILER_MAX_SAMPLES (1 << 15)
+
+namespace cliex
+{
+namespace profiler
+{
+bool start(const std::string&);
+bool stop();
+
+void register_thread();
+void unregister_thread();
+
+struct thread_guard
+{
+    thread_guard()
+    {
+        register_thread();
+    }
+
+    ~thread_guard()
+    {
+        unregister_thread();
+    }
+};
+}
+}
@@ -0,0 +1,109 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+
+/**
+ * query.hpp
+ *
+ * Filter expressions typed into the explorer, e.g.
+ *
+ *     size > 1G and mtime < 7d and name ~ "*.log"
+ *
+ * The fields are name (~ and !~ match a glob, = and != compare), type (file,
+ * dir, symlink or other), size and mtime, the age of the last modification.
+ * Tests combine with and, or, not and parentheses.
+ *
+ * An expression is compiled once into a flat program for a machine with a
+ * single boolean register. and/or jump over what can't change the result,
+ * so an entry is only stat'ed once a test that needs its metadata is
+ * reached.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "glob.hpp"
+
+#define QUERY_CHUNK_SIZE 16384
+
+namespace cliex
+{
+struct listing;
+
+class query
+{
+public:
+    // throws std::invalid_argument with the reason
+    explicit query(const std::string&);
+
+    /*
+     * Appends the indexes of the matching entries in [begin, end) of the
+     * listing to the vector, ".." always matches. Chunks of one listing can
+     * be selected in parallel. Throws fs::filesystem_error if the directory
+     * can't be opened.
+    */
+    void select(const listing&, size_t, size_t, std::vector<size_t>&) const;
+
+private:
+    enum opcode : unsigned char
+    {
+        OP_NAME_GLOB,
+        OP_NAME_EQUAL,
+        OP_TYPE,
+        OP_SIZE,
+        OP_AGE,
+        OP_NOT,
+        // jump to value if the register is false, or true
+        OP_JUMP_FALSE,
+        OP_JUMP_TRUE
+    };
+
+    enum compare : unsigned char
+    {
+        CMP_EQ,
+        CMP_NE,
+        CMP_LT,
+        CMP_LE,
+        CMP_GT,
+        CMP_GE
+    };
+
+    // value is a number, a type mask, a jump target or an index into globs
+    // or names
+    struct instr
+    {
+        opcode code;
+        compare cmp;
+        long long value;
+    };
+
+    struct entry;
+    class parser;
+
+    std::vector<instr> code;
+    std::vector<glob> globs;
+    std::vector<std::string> names;
+    long long now;
+
+    static bool holds(long long, compare, long long);
+    bool matches(entry&) const;
+};
+}
@@ -0,0 +1,52 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * script.hpp
+ *
+ * Headless mode: the main loop reads its keys from a script file and ncurses
+ * draws into a terminal that nobody looks at. Every key is timed, the bytes
+ * sent to the terminal are counted and the final screen can be dumped as
+ * text.
+*/
+
+#pragma once
+
+#include <string>
+#include <ostream>
+
+#include <ncurses.h>
+
+#define SCRIPT_TERM "xterm"
+
+namespace cliex
+{
+namespace script
+{
+bool load(const std::string&);
+SCREEN *open_screen();
+int output_fd();
+// false once the script is over
+bool next_key(int&);
+// the terminal size of the last resize key
+bool size(int&, int&);
+
+std::string screen_text();
+void report(std::ostream&);
+}
+}
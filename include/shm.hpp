@@ -0,0 +1,66 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * shm.hpp
+ *
+ * Listings shared by all explorers of a user through a segment in /dev/shm.
+ * A listing is filed under the device, inode and modification time of its
+ * directory, so it's only found while the directory is unchanged, and one
+ * stat replaces reading the directory again.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#define SHM_SEGMENT_SIZE (64 << 20)
+#define SHM_INDEX_SLOTS 8192
+// slots a directory may be filed in, starting at its hash
+#define SHM_PROBES 4
+#define SHM_MAX_READERS 64
+// a writer waits this long for readers of the space it reuses
+#define SHM_WAIT_MS 50
+// directories changed more recently than this may change again within the
+// same mtime tick, their listings aren't shared
+#define SHM_RACY_NS 2000000000LL
+
+namespace cliex
+{
+namespace shm
+{
+struct key
+{
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+    int64_t mtime_ns = 0;
+};
+
+// maps the segment of this user, creating it if needed
+bool open();
+bool enabled();
+
+// the listing filed under k, false if there is none
+bool find(const key&, std::vector<std::string>&);
+// files a listing that was read while the directory had key k
+void publish(const key&, const std::vector<std::string>&);
+}
+}
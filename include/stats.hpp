@@ -0,0 +1,104 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * stats.hpp
+ *
+ * Accounting of filesystem calls. Everything the explorer asks the filesystem
+ * goes through get_vfs() or cliex::sys, which count the calls and their
+ * cumulative time per call type and per UI action. Next to that it keeps
+ * track of how much memory the current listing takes.
+*/
+
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <chrono>
+
+#include <experimental/filesystem>
+
+#include <ncurses.h>
+
+namespace fs = std::experimental::filesystem;
+
+namespace cliex
+{
+namespace stats
+{
+enum call
+{
+    CALL_STATUS,
+    CALL_SYMLINK_STATUS,
+    CALL_DIR_OPEN,
+    CALL_DIR_READ,
+    CALL_FILE_SIZE,
+    CALL_LAST_WRITE_TIME,
+    CALL_OPEN,
+    CALL_READ,
+    CALL_OWNER,
+    // user and group names from NSS
+    CALL_NAME_LOOKUP,
+    CALL_COUNT
+};
+
+const char *call_name(call);
+
+void begin_action(const char *);
+void record(call, long long);
+
+struct footprint
+{
+    size_t entries = 0;
+    size_t names = 0;
+    size_t widths = 0;
+    size_t layout = 0;
+    size_t types = 0;
+};
+
+void mark_phase(const char *);
+
+void set_footprint(const footprint&);
+long rss_kb();
+long peak_rss_kb();
+
+void draw_overlay(WINDOW*, int);
+std::string dump();
+
+struct timer
+{
+    call c;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    ~timer()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        record(c, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+};
+}
+
+// listings and metadata go through get_vfs(), these are for the files the
+// explorer reads itself
+namespace sys
+{
+fs::file_status status(const fs::path&);
+std::fstream open(const fs::path&, std::ios::openmode);
+bool read_line(std::istream&, std::string&);
+}
+}
@@ -0,0 +1,62 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+
+/**
+ * timestamp.hpp
+ *
+ * Modification times for the file information, written into a caller's
+ * buffer without allocating and without going through the C library's
+ * locale machinery. The UTC offset is looked up once per stretch of time it
+ * holds for, between two daylight saving changes, as long as that pays off;
+ * everything else is integer arithmetic.
+*/
+
+#pragma once
+
+#include <string>
+#include <stdexcept>
+
+// enough for every style, with the terminating NUL
+#define TIMESTAMP_SIZE 32
+// stretches with a known UTC offset, per thread
+#define TIMESTAMP_SPANS 32
+// offset lookups a span may take to find, see timestamp.cpp
+#define TIMESTAMP_SEARCH_COST 128
+
+namespace cliex
+{
+namespace timestamp
+{
+enum style
+{
+    // 2024-05-01 13:45:07
+    STYLE_ISO,
+    // just now, 5 min ago, today 13:45, yesterday 13:45, 3 days ago, then
+    // the ISO date
+    STYLE_RELATIVE
+};
+
+// throws std::invalid_argument for anything but iso and relative
+style parse_style(const std::string&);
+
+// seconds since the epoch, in local time; returns the length written
+size_t format(long long, style, char*, long long now);
+size_t format(long long, style, char*);
+}
+}
@@ -0,0 +1,122 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * tree.hpp
+ *
+ * The tree view: directories expand in place. The visible rows are never
+ * copied out of the listings; the tree is a sequence of segments, each a
+ * range of one listing at one depth. Expanding a node splits its segment
+ * and puts the child listing in between, collapsing removes the segments
+ * below it and joins the two halves again. Both cost a step per segment,
+ * however many entries come or go, and drawing only touches visible rows.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include <experimental/filesystem>
+
+#include <ncurses.h>
+
+#include "cliex.hpp"
+
+// columns per level
+#define TREE_INDENT 2
+
+namespace fs = std::experimental::filesystem;
+
+namespace cliex
+{
+class tree_view
+{
+public:
+    ~tree_view();
+
+    void place(WINDOW*, int, int, int, int);
+    void close();
+    WINDOW *window() const
+    {
+        return win;
+    }
+
+    // the whole tree collapsed to this listing
+    void assign(std::shared_ptr<listing>);
+    // after the window was placed anew
+    void reflow();
+
+    // expands the directory under the cursor, its listing may still load
+    void expand(const std::vector<std::string>&);
+    // collapses the node under the cursor, or moves to its parent
+    void collapse();
+    // shows the children of expanded nodes whose listings have loaded,
+    // returns whether there were any
+    bool update();
+    // an entry of a listing was inserted or erased, returns whether it is
+    // part of the tree
+    bool changed(const listing&, size_t, bool);
+
+    void down();
+    void up();
+    void page_down();
+    void page_up();
+
+    // draws the mark f returns after the expand mark of an entry, unless
+    // it's 0; f may be empty
+    void marks(std::function<char(const listing&, size_t)> f)
+    {
+        mark_of = std::move(f);
+    }
+
+    size_t rows() const;
+    std::string selected() const;
+    // the directory the selected entry is in
+    fs::path selected_dir() const;
+
+    void draw();
+
+private:
+    struct segment
+    {
+        std::shared_ptr<listing> shown;
+        size_t first;
+        size_t last;
+        unsigned depth;
+        // the listing was still loading when it was expanded
+        bool loading;
+    };
+
+    WINDOW *win = nullptr;
+    std::vector<segment> segments;
+    // the first row of every segment
+    std::vector<size_t> starts;
+    size_t current = 0;
+    size_t top = 0;
+    std::function<char(const listing&, size_t)> mark_of;
+
+    size_t locate(size_t) const;
+    bool expanded(size_t) const;
+    void restart(size_t);
+    void remove_children(size_t);
+    void move_to(size_t);
+};
+}
@@ -0,0 +1,150 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * vfs.hpp
+ *
+ * The filesystem as the explorer sees it. get_dir_content, get_type and
+ * show_file_info only talk to the vfs returned by get_vfs(), which is either
+ * the local filesystem or an in-memory tree, optionally wrapped in a layer
+ * that injects latency and failures.
+*/
+
+#pragma once
+
+#include <string>
+
+#include <vector>
+#include <unordered_map>
+
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <random>
+
+#include <experimental/filesystem>
+
+namespace fs = std::experimental::filesystem;
+
+namespace cliex
+{
+struct ownership
+{
+    unsigned uid;
+    unsigned gid;
+};
+
+class vfs
+{
+public:
+    virtual ~vfs() = default;
+
+    virtual fs::file_status status(const fs::path&) = 0;
+    virtual fs::file_status symlink_status(const fs::path&) = 0;
+    virtual void list_dir(const fs::path&, const std::function<void(const std::string&)>&) = 0;
+    virtual std::uintmax_t file_size(const fs::path&) = 0;
+    virtual fs::file_time_type last_write_time(const fs::path&) = 0;
+    virtual ownership owner(const fs::path&) = 0;
+
+    // whether paths name real files, which may then be read directly
+    virtual bool native()
+    {
+        return false;
+    }
+};
+
+class local_vfs : public vfs
+{
+public:
+    fs::file_status status(const fs::path&) override;
+    fs::file_status symlink_status(const fs::path&) override;
+    void list_dir(const fs::path&, const std::function<void(const std::string&)>&) override;
+    std::uintmax_t file_size(const fs::path&) override;
+    fs::file_time_type last_write_time(const fs::path&) override;
+    ownership owner(const fs::path&) override;
+
+    bool native() override
+    {
+        return true;
+    }
+};
+
+/*
+ * Directories created with add_synthetic() don't store their entries, the
+ * attributes of every entry are derived from its name. That way a directory
+ * with millions of entries costs nothing but the explorer's own memory.
+*/
+class memory_vfs : public vfs
+{
+public:
+    void add_dir(const fs::path&);
+    void add_file(const fs::path&, std::uintmax_t);
+    void add_synthetic(const fs::path&, size_t);
+
+    fs::file_status status(const fs::path&) override;
+    fs::file_status symlink_status(const fs::path&) override;
+    void list_dir(const fs::path&, const std::function<void(const std::string&)>&) override;
+    std::uintmax_t file_size(const fs::path&) override;
+    fs::file_time_type last_write_time(const fs::path&) override;
+    ownership owner(const fs::path&) override;
+
+private:
+    struct node
+    {
+        fs::file_type type;
+        fs::perms perms;
+        std::uintmax_t size;
+        fs::file_time_type mtime;
+        std::vector<std::string> children;
+        size_t synthetic;
+    };
+
+    std::unordered_map<std::string, node> nodes;
+
+    void add_node(const fs::path&, node);
+    const node *find(const fs::path&, node&);
+    const node &get(const fs::path&, node&);
+};
+
+class latency_vfs : public vfs
+{
+public:
+    latency_vfs(std::unique_ptr<vfs>, int, int, double);
+
+    fs::file_status status(const fs::path&) override;
+    fs::file_status symlink_status(const fs::path&) override;
+    void list_dir(const fs::path&, const std::function<void(const std::string&)>&) override;
+    std::uintmax_t file_size(const fs::path&) override;
+    fs::file_time_type last_write_time(const fs::path&) override;
+    ownership owner(const fs::path&) override;
+
+private:
+    std::unique_ptr<vfs> inner;
+    int latency_ms;
+    int jitter_ms;
+    double failure_rate;
+
+    std::mutex mtx;
+    std::mt19937 rng{std::random_device{}()};
+
+    void delay(const fs::path&);
+};
+
+vfs &get_vfs();
+void set_vfs(std::unique_ptr<vfs>);
+}
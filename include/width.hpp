@@ -0,0 +1,44 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * width.hpp
+ *
+ * The number of terminal columns a file name takes, as ncurses will draw it.
+ * Names are measured once when a listing is loaded; layout code only uses
+ * the cached widths.
+*/
+
+#pragma once
+
+#include <string>
+
+#define MAX_DISPLAY_WIDTH 0xFFFF
+
+namespace cliex
+{
+unsigned display_width(const char*, size_t);
+
+inline unsigned display_width(const std::string &s)
+{
+    return display_width(s.data(), s.size());
+}
+
+// the number of bytes of s that fit into the given number of columns
+size_t display_prefix(const std::string&, unsigned);
+}
@@ -0,0 +1,524 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * aio.cpp
+ *
+ * The ring is only used from the main thread: it submits and it reaps in
+ * dispatch(), so neither side needs a lock. Coroutines suspended on a worker
+ * do their I/O as blocking calls on the pool instead. Both kinds of
+ * completions wake the main loop through the same eventfd.
+*/
+
+#include <vector>
+
+#include <algorithm>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/io_uring.h>
+
+#include "aio.hpp"
+#include "pool.hpp"
+
+// entries handed to one pool task by the fallback of statx_all
+#define AIO_FALLBACK_BATCH 256
+
+namespace
+{
+struct ring
+{
+    int fd = -1;
+    unsigned entries = 0;
+    unsigned in_flight = 0;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    io_uring_sqe *sqes;
+
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+};
+
+ring uring;
+int efd = -1;
+std::thread::id main_thread;
+
+std::mutex queue_mtx;
+std::vector<std::coroutine_handle<>> main_queue;
+
+std::atomic<size_t> live_tasks{0};
+
+// other descriptors the main loop waits for, with what to run when readable
+std::vector<std::pair<int, std::function<void()>>> watched;
+std::vector<pollfd> poll_set;
+
+struct detached
+{
+    struct promise_type
+    {
+        detached get_return_object()
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+        }
+    };
+};
+
+detached run_detached(cliex::aio::task<void> t)
+{
+    try
+    {
+        co_await t;
+    }
+    catch (...)
+    {
+    }
+    live_tasks--;
+}
+
+bool on_main()
+{
+    return std::this_thread::get_id() == main_thread;
+}
+
+int syscall_result(long res)
+{
+    return res < 0 ? -errno : static_cast<int>(res);
+}
+
+// kernels before 5.6 can't tell, and don't have these opcodes either
+bool supports_ops(int fd)
+{
+    const unsigned count = 256;
+    std::vector<char> buf(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op));
+    auto probe = reinterpret_cast<io_uring_probe *>(buf.data());
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, count))
+        return false;
+
+    for (unsigned op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE})
+    {
+        if (op >= probe->ops_len || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+            return false;
+    }
+    return true;
+}
+
+bool setup_ring()
+{
+    io_uring_params p = {};
+    int fd = syscall(__NR_io_uring_setup, AIO_QUEUE_DEPTH, &p);
+    if (fd < 0)
+        return false;
+
+    // without NODROP, completions are lost when the completion queue
+    // overflows; an opcode the kernel doesn't know fails every request
+    if (!(p.features & IORING_FEAT_NODROP) || !supports_ops(fd))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+        sq_size = cq_size = std::max(sq_size, cq_size);
+
+    auto sq = static_cast<char *>(mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING));
+    if (sq == MAP_FAILED)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    auto cq = sq;
+    if (!single)
+        cq = static_cast<char *>(mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING));
+
+    auto sqes = mmap(nullptr, p.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (cq == MAP_FAILED || sqes == MAP_FAILED || syscall(__NR_io_uring_register, fd, IORING_REGISTER_EVENTFD, &efd, 1))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    uring.fd = fd;
+    uring.entries = p.cq_entries;
+    uring.sq_head = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    uring.sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    uring.sq_mask = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    uring.sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    uring.sqes = static_cast<io_uring_sqe *>(sqes);
+    uring.cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    uring.cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    uring.cq_mask = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    uring.cqes = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+    return true;
+}
+
+void reap()
+{
+    unsigned head = *uring.cq_head;
+    unsigned tail = __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        const auto &cqe = uring.cqes[head & *uring.cq_mask];
+        auto req = reinterpret_cast<cliex::aio::detail::request *>(cqe.user_data);
+        req->res = cqe.res;
+        cliex::aio::detail::complete(*req->parent);
+
+        head++;
+        uring.in_flight--;
+    }
+    __atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Only called on the main thread. The number of requests in flight is kept
+ * below the size of the completion queue, so it never overflows.
+*/
+void submit(cliex::aio::detail::request &r, const std::function<void(io_uring_sqe&)> &prepare)
+{
+    while (uring.in_flight >= uring.entries)
+    {
+        syscall(__NR_io_uring_enter, uring.fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        reap();
+    }
+
+    unsigned tail = *uring.sq_tail;
+    unsigned index = tail & *uring.sq_mask;
+    auto &sqe = uring.sqes[index];
+    sqe = {};
+    prepare(sqe);
+    sqe.user_data = reinterpret_cast<__u64>(&r);
+    uring.sq_array[index] = index;
+    __atomic_store_n(uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    uring.in_flight++;
+
+    while (syscall(__NR_io_uring_enter, uring.fd, 1, 0, 0, nullptr, 0) < 0)
+    {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            // the kernel didn't take the request, take it back
+            __atomic_store_n(uring.sq_tail, tail, __ATOMIC_RELEASE);
+            uring.in_flight--;
+            r.res = -errno;
+            cliex::aio::detail::complete(*r.parent);
+            return;
+        }
+        reap();
+    }
+}
+
+bool use_ring(const cliex::aio::detail::request &r)
+{
+    return uring.fd >= 0 && r.parent->on_main;
+}
+
+void run_blocking(cliex::aio::detail::request &r, std::function<int()> f)
+{
+    cliex::pool::submit([&r, f]
+    {
+        cliex::pool::io_slot io;
+        r.res = f();
+        cliex::aio::detail::complete(*r.parent);
+    }, cliex::PRIORITY_VISIBLE);
+}
+
+bool run_main_queue()
+{
+    std::vector<std::coroutine_handle<>> ready;
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        ready.swap(main_queue);
+    }
+
+    for (auto h : ready)
+        h.resume();
+    return !ready.empty();
+}
+}
+
+void cliex::aio::notify()
+{
+    uint64_t one = 1;
+    while (write(efd, &one, sizeof one) < 0 && errno == EINTR)
+    {
+    }
+}
+
+bool cliex::aio::init()
+{
+    main_thread = std::this_thread::get_id();
+    if (efd < 0)
+        efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return uring.fd >= 0 || setup_ring();
+}
+
+const char *cliex::aio::backend()
+{
+    return uring.fd >= 0 ? "io_uring" : "thread pool";
+}
+
+int cliex::aio::event_fd()
+{
+    return efd;
+}
+
+void cliex::aio::detail::suspend(completion &c, std::coroutine_handle<> h, size_t requests)
+{
+    c.handle = h;
+    c.on_main = on_main();
+    c.remaining = requests;
+}
+
+void cliex::aio::detail::complete(completion &c)
+{
+    if (--c.remaining)
+        return;
+
+    if (!c.on_main)
+    {
+        auto h = c.handle;
+        pool::submit([h]
+        {
+            h.resume();
+        }, PRIORITY_VISIBLE);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx);
+        main_queue.push_back(c.handle);
+    }
+    notify();
+}
+
+void cliex::aio::detail::open(request &r, const std::string &path, int flags)
+{
+    if (use_ring(r))
+    {
+        submit(r, [&path, flags](io_uring_sqe &sqe)
+        {
+            sqe.opcode = IORING_OP_OPENAT;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<__u64>(path.c_str());
+            sqe.open_flags = flags | O_CLOEXEC;
+        });
+        return;
+    }
+
+    run_blocking(r, [&path, flags]
+    {
+        return syscall_result(::open(path.c_str(), flags | O_CLOEXEC));
+    });
+}
+
+void cliex::aio::detail::statx(request &r, int dirfd, const std::string &path, struct statx *out)
+{
+    if (use_ring(r))
+    {
+        submit(r, [dirfd, &path, out](io_uring_sqe &sqe)
+        {
+            sqe.opcode = IORING_OP_STATX;
+            sqe.fd = dirfd;
+            sqe.addr = reinterpret_cast<__u64>(path.c_str());
+            sqe.len = STATX_BASIC_STATS;
+            sqe.off = reinterpret_cast<__u64>(out);
+        });
+        return;
+    }
+
+    run_blocking(r, [dirfd, &path, out]
+    {
+        return syscall_result(::statx(dirfd, path.c_str(), 0, STATX_BASIC_STATS, out));
+    });
+}
+
+void cliex::aio::detail::read(request &r, int fd, void *buf, unsigned len, off_t offset)
+{
+    if (use_ring(r))
+    {
+        submit(r, [=](io_uring_sqe &sqe)
+        {
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = fd;
+            sqe.addr = reinterpret_cast<__u64>(buf);
+            sqe.len = len;
+            sqe.off = offset;
+        });
+        return;
+    }
+
+    run_blocking(r, [=]
+    {
+        return syscall_result(pread(fd, buf, len, offset));
+    });
+}
+
+void cliex::aio::detail::close(request &r, int fd)
+{
+    if (use_ring(r))
+    {
+        submit(r, [fd](io_uring_sqe &sqe)
+        {
+            sqe.opcode = IORING_OP_CLOSE;
+            sqe.fd = fd;
+        });
+        return;
+    }
+
+    run_blocking(r, [fd]
+    {
+        return syscall_result(::close(fd));
+    });
+}
+
+void cliex::aio::detail::getdents(request &r, int fd, void *buf, unsigned len)
+{
+    run_blocking(r, [=]
+    {
+        return syscall_result(syscall(SYS_getdents64, fd, buf, len));
+    });
+}
+
+void cliex::aio::statx_batch::await_suspend(std::coroutine_handle<> h)
+{
+    // the coroutine may be resumed before this returns, so don't touch
+    // any member after the last request went out
+    size_t n = names.size();
+    out.resize(n);
+    reqs.assign(n, {&done, 0});
+    detail::suspend(done, h, n);
+
+    if (use_ring(reqs[0]))
+    {
+        for (size_t i = 0; i < n; i++)
+            detail::statx(reqs[i], dirfd, names[i], &out[i]);
+        return;
+    }
+
+    for (size_t first = 0; first < n; first += AIO_FALLBACK_BATCH)
+    {
+        size_t last = std::min(n, first + AIO_FALLBACK_BATCH);
+        pool::submit([this, first, last]
+        {
+            pool::io_slot io;
+            for (size_t i = first; i < last; i++)
+            {
+                reqs[i].res = syscall_result(::statx(dirfd, names[i].c_str(), 0, STATX_BASIC_STATS, &out[i]));
+                detail::complete(done);
+            }
+        }, PRIORITY_VISIBLE);
+    }
+}
+
+std::vector<int> cliex::aio::statx_batch::await_resume() const
+{
+    std::vector<int> res(reqs.size());
+    for (size_t i = 0; i < reqs.size(); i++)
+        res[i] = reqs[i].res;
+    return res;
+}
+
+void cliex::aio::spawn(task<void> t)
+{
+    live_tasks++;
+    run_detached(std::move(t));
+}
+
+void cliex::aio::dispatch()
+{
+    uint64_t count;
+    while (::read(efd, &count, sizeof count) > 0)
+    {
+    }
+
+    do
+    {
+        if (uring.fd >= 0)
+            reap();
+    }
+    while (run_main_queue());
+}
+
+bool cliex::aio::wait(int fd)
+{
+    poll_set.assign({{fd, POLLIN, 0}, {efd, POLLIN, 0}});
+    for (const auto &w : watched)
+        poll_set.push_back({w.first, POLLIN, 0});
+
+    while (poll(poll_set.data(), poll_set.size(), -1) < 0)
+    {
+        if (errno != EINTR)
+            return true;
+    }
+
+    if (poll_set[1].revents)
+        dispatch();
+    for (size_t i = 2; i < poll_set.size(); i++)
+    {
+        if (poll_set[i].revents)
+            watched[i - 2].second();
+    }
+    return poll_set[0].revents;
+}
+
+void cliex::aio::on_readable(int fd, std::function<void()> f)
+{
+    watched.emplace_back(fd, std::move(f));
+}
+
+void cliex::aio::wait_idle()
+{
+    dispatch();
+    while (live_tasks)
+    {
+        pollfd p = {efd, POLLIN, 0};
+        if (poll(&p, 1, -1) < 0 && errno != EINTR)
+            return;
+        dispatch();
+    }
+}
@@ -0,0 +1,424 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * cache.cpp
+ *
+ * Events that arrive while a listing is still loading are kept and replayed
+ * once it is done. Replaying is idempotent, an insert of a name that is
+ * already listed and an erase of one that isn't do nothing, so it doesn't
+ * matter whether the enumeration saw the change or not.
+ *
+ * Adding a watch looks the path up, which may block on a slow mount, so it
+ * happens on the pool like the listing itself.
+*/
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <algorithm>
+#include <chrono>
+
+#include <memory>
+#include <functional>
+
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+#include "cache.hpp"
+#include "cliex.hpp"
+#include "vfs.hpp"
+#include "aio.hpp"
+#include "width.hpp"
+#include "ignore.hpp"
+#include "filter.hpp"
+
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+namespace
+{
+struct change
+{
+    std::string name;
+    uint32_t mask;
+};
+
+struct entry
+{
+    std::shared_ptr<cliex::listing> listing;
+    int wd = -1;
+    unsigned long used = 0;
+    std::chrono::steady_clock::time_point listed;
+    std::vector<change> queued;
+};
+
+std::unordered_map<std::string, std::unique_ptr<entry>> entries;
+// paths that lead to the same directory share one watch
+std::unordered_multimap<int, entry *> by_watch;
+
+int inotify_fd = -1;
+unsigned long last_use = 0;
+size_t max_listings = CACHE_MAX_LISTINGS;
+cliex::entry_filter filter;
+bool hide_ignored = false;
+std::function<void(const cliex::listing&, size_t, bool)> changed;
+
+void unwatch(entry &e)
+{
+    if (e.wd < 0)
+        return;
+
+    auto range = by_watch.equal_range(e.wd);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == &e)
+        {
+            by_watch.erase(it);
+            break;
+        }
+    }
+    if (!by_watch.count(e.wd))
+        inotify_rm_watch(inotify_fd, e.wd);
+    e.wd = -1;
+}
+
+void drop(const std::string &dir)
+{
+    auto it = entries.find(dir);
+    if (it == entries.end())
+        return;
+
+    unwatch(*it->second);
+    entries.erase(it);
+}
+
+// only listings that nothing else holds can go
+void evict()
+{
+    while (entries.size() > max_listings)
+    {
+        auto oldest = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (it->second->listing.use_count() == 1 && (oldest == entries.end() || it->second->used < oldest->second->used))
+                oldest = it;
+        }
+        if (oldest == entries.end())
+            return;
+
+        unwatch(*oldest->second);
+        entries.erase(oldest);
+    }
+}
+
+bool lists_as_directory(const fs::path &p)
+{
+    try
+    {
+        return fs::is_directory(cliex::get_vfs().status(p));
+    }
+    catch (const fs::filesystem_error&)
+    {
+        return false;
+    }
+}
+
+bool passes(const fs::path &p)
+{
+    try
+    {
+        return filter.by_status(p, cliex::get_vfs().status(p));
+    }
+    catch (const fs::filesystem_error&)
+    {
+        return false;
+    }
+}
+
+void apply(cliex::listing &l, const change &c)
+{
+    if (c.name == ".gitignore" || c.name == ".ignore")
+        cliex::ignore::forget();
+    if (!l.error.empty() || c.name.empty() || filter.by_name(c.name.c_str(), DT_UNKNOWN) == cliex::FILTER_DROP)
+        return;
+
+    auto &names = l.entries;
+    auto find = [&names](const std::string &name)
+    {
+        auto it = std::lower_bound(names.begin(), names.end(), name, cliex::entry_less);
+        return std::make_pair(it, it != names.end() && *it == name);
+    };
+
+    if (c.mask & (IN_CREATE | IN_MOVED_TO))
+    {
+        // links to directories are listed as directories too
+        std::string name = c.name;
+        if (c.mask & IN_ISDIR || lists_as_directory(l.dir / name))
+            name += "/";
+        auto verdict = filter.by_name(c.name.c_str(), name.back() == '/' ? DT_DIR : DT_UNKNOWN);
+        if (verdict == cliex::FILTER_DROP || verdict == cliex::FILTER_SKIP || (verdict == cliex::FILTER_STAT && !passes(l.dir / c.name)))
+            return;
+        if (hide_ignored && cliex::get_vfs().native())
+        {
+            auto ignores = cliex::ignore::for_dir(l.dir.string());
+            if (ignores && ignores->ignored(c.name, name.back() == '/'))
+                return;
+        }
+
+        auto found = find(name);
+        if (found.second)
+            return;
+
+        size_t index = found.first - names.begin();
+        names.insert(found.first, name);
+        l.widths.insert(l.widths.begin() + index, cliex::display_width(name));
+        if (changed)
+            changed(l, index, true);
+    }
+    else
+    {
+        // the event doesn't tell a link to a directory from a file
+        auto found = find(c.name);
+        if (!found.second)
+            found = find(c.name + "/");
+        if (!found.second)
+            return;
+
+        size_t index = found.first - names.begin();
+        names.erase(found.first);
+        l.widths.erase(l.widths.begin() + index);
+        if (changed)
+            changed(l, index, false);
+    }
+}
+
+void read_events()
+{
+    alignas(inotify_event) char buf[CACHE_EVENT_BATCH * (sizeof(inotify_event) + NAME_MAX + 1)];
+    ssize_t n;
+    while ((n = read(inotify_fd, buf, sizeof buf)) > 0)
+    {
+        for (char *p = buf; p < buf + n;)
+        {
+            auto ev = reinterpret_cast<const inotify_event *>(p);
+            p += sizeof(inotify_event) + ev->len;
+
+            // events were lost, nothing cached can be trusted; what's on
+            // screen stays until it's listed again
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                while (!entries.empty())
+                    drop(entries.begin()->first);
+                continue;
+            }
+
+            std::vector<entry *> targets;
+            auto range = by_watch.equal_range(ev->wd);
+            for (auto it = range.first; it != range.second; ++it)
+                targets.push_back(it->second);
+
+            for (auto e : targets)
+            {
+                if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_IGNORED))
+                {
+                    drop(e->listing->dir.string());
+                    continue;
+                }
+
+                change c{ev->len ? ev->name : "", ev->mask};
+                if (e->listing->done)
+                    apply(*e->listing, c);
+                else
+                    e->queued.push_back(std::move(c));
+            }
+        }
+    }
+}
+
+entry *find(const std::shared_ptr<cliex::listing> &l)
+{
+    auto it = entries.find(l->dir.string());
+    return it != entries.end() && it->second->listing == l ? it->second.get() : nullptr;
+}
+
+int watch_fd()
+{
+    if (inotify_fd < 0 && cliex::get_vfs().native())
+    {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd >= 0)
+            cliex::aio::on_readable(inotify_fd, read_events);
+    }
+    return cliex::get_vfs().native() ? inotify_fd : -1;
+}
+
+// changes made by other machines are never reported there
+bool remote(int dirfd)
+{
+    struct statfs fs;
+    if (fstatfs(dirfd, &fs))
+        return true;
+    switch (fs.f_type)
+    {
+    case NFS_SUPER_MAGIC:
+    case SMB_SUPER_MAGIC:
+    case SMB2_SUPER_MAGIC:
+    case CIFS_SUPER_MAGIC:
+    case CEPH_SUPER_MAGIC:
+    case FUSE_SUPER_MAGIC:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// the path is resolved once, the watch and the listing's identity come from
+// the same directory, and the listing checks that it read that one
+int watch(int fd, const std::string &path, cliex::listing &l)
+{
+    int dirfd = ::open(path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+        return -1;
+
+    struct stat st;
+    int wd = -1;
+    if (fstat(dirfd, &st) == 0)
+    {
+        l.dev = st.st_dev;
+        l.ino = st.st_ino;
+        if (!remote(dirfd))
+            wd = inotify_add_watch(fd, ("/proc/self/fd/" + std::to_string(dirfd)).c_str(), WATCH_MASK);
+    }
+    ::close(dirfd);
+    return wd;
+}
+
+cliex::aio::task<void> load(std::shared_ptr<cliex::listing> l, std::vector<std::string> opts)
+{
+    // the watch comes first, so nothing that happens during the listing is missed
+    int fd = watch_fd();
+    if (fd >= 0)
+    {
+        std::string path = l->dir.string();
+        int wd = co_await cliex::aio::offload([fd, &path, &l]
+        {
+            cliex::pool::io_slot io;
+            return watch(fd, path, *l);
+        }, l->speculative ? cliex::PRIORITY_PREFETCH : cliex::PRIORITY_VISIBLE);
+
+        auto e = find(l);
+        if (e && wd >= 0)
+        {
+            e->wd = wd;
+            by_watch.emplace(wd, e);
+        }
+        else if (wd >= 0 && !by_watch.count(wd))
+        {
+            inotify_rm_watch(fd, wd);
+        }
+    }
+
+    co_await cliex::load_listing(l, std::move(opts));
+
+    auto e = find(l);
+    if (!e)
+        co_return;
+
+    auto queued = std::move(e->queued);
+    for (const auto &c : queued)
+        apply(*l, c);
+}
+
+std::shared_ptr<cliex::listing> lookup(const fs::path &dir, const std::vector<std::string> &opts, bool speculative)
+{
+    filter = cliex::entry_filter{opts};
+    hide_ignored = opts[INDEX_ARG_HIDE_IGNORED] == "true";
+
+    // a failed listing is tried again, one without a watch once it may
+    // be out of date
+    auto it = entries.find(dir.string());
+    if (it != entries.end() && it->second->listing->done && (!it->second->listing->error.empty()
+        || (it->second->wd < 0 && std::chrono::steady_clock::now() - it->second->listed > std::chrono::milliseconds(CACHE_UNWATCHED_TTL_MS))))
+    {
+        drop(dir.string());
+        it = entries.end();
+    }
+
+    if (it != entries.end())
+    {
+        auto &l = it->second->listing;
+        it->second->used = ++last_use;
+        if (!speculative)
+            l->speculative = false;
+        return l;
+    }
+
+    auto e = std::make_unique<entry>();
+    auto l = std::make_shared<cliex::listing>();
+    l->dir = dir;
+    l->speculative = speculative;
+    if (speculative)
+        l->cancel = cliex::cancel_token::create();
+    e->listing = l;
+    e->used = ++last_use;
+    e->listed = std::chrono::steady_clock::now();
+
+    entries.emplace(dir.string(), std::move(e));
+    evict();
+
+    cliex::aio::spawn(load(l, opts));
+    return l;
+}
+}
+
+std::shared_ptr<cliex::listing> cliex::cache::get(const fs::path &dir, const std::vector<std::string> &opts)
+{
+    return lookup(dir, opts, false);
+}
+
+std::shared_ptr<cliex::listing> cliex::cache::prefetch(const fs::path &dir, const std::vector<std::string> &opts)
+{
+    return lookup(dir, opts, true);
+}
+
+void cliex::cache::cancel(const std::shared_ptr<listing> &l)
+{
+    if (!l || l->done || !l->speculative)
+        return;
+
+    l->cancel.cancel();
+    if (find(l))
+        drop(l->dir.string());
+}
+
+void cliex::cache::limit(size_t n)
+{
+    max_listings = n;
+    evict();
+}
+
+void cliex::cache::on_change(std::function<void(const listing&, size_t, bool)> f)
+{
+    changed = std::move(f);
+}
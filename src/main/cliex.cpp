@@ -25,6 +25,7 @@
 #include <fstream>
 
 #include <string>
+#include <cstring>
 
 #include <vector>
 #include <map>
@@ -38,18 +39,52 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <pwd.h>
+#include <malloc.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 
-#include <menu.h>
 #include <ncurses.h>
 
 #include "cliex.hpp"
+#include "stats.hpp"
+#include "vfs.hpp"
+#include "perf.hpp"
+#include "aio.hpp"
+#include "pool.hpp"
+#include "frame.hpp"
+#include "width.hpp"
+#include "tree.hpp"
+#include "daemon.hpp"
+#include "shm.hpp"
+#include "ignore.hpp"
+#include "filter.hpp"
+#include "query.hpp"
+#include "owners.hpp"
+#include "info.hpp"
 
 namespace fs = std::experimental::filesystem;
 using std::literals::string_literals::operator""s;
 
+// glibc keeps the chunk size in front of every allocation
+#define MALLOC_OVERHEAD sizeof(size_t)
+
+static size_t heap_size(const void *p)
+{
+    return p ? malloc_usable_size(const_cast<void *>(p)) + MALLOC_OVERHEAD : 0;
+}
+
+static size_t heap_size(const std::string &s)
+{
+    return s.capacity() > std::string().capacity() ? heap_size(s.data()) : 0;
+}
+
 std::map<std::string, std::string> cliex::get_all_types()
 {
-    if (!fs::exists(USER_TYPES_PATH))
+    if (!fs::exists(sys::status(USER_TYPES_PATH)))
     {
         fs::create_directory(USER_TYPES_PATH.parent_path());
         fs::copy(DEFAULT_TYPES_PATH, USER_TYPES_PATH);
@@ -57,13 +92,13 @@ std::map<std::string, std::string> cliex::get_all_types()
 
     auto user_types = load_config(USER_TYPES_PATH);
 
-    if (fs::exists(DEFAULT_TYPES_PATH))
+    if (fs::exists(sys::status(DEFAULT_TYPES_PATH)))
     {
         auto default_types = load_config(DEFAULT_TYPES_PATH);
         if (user_types.size() != default_types.size() || !std::equal(user_types.begin(), user_types.end(), default_types.begin()))
         {
             user_types.insert(default_types.begin(), default_types.end());
-            std::fstream overwrite{USER_TYPES_PATH, std::ios::out | std::ios::trunc};
+            auto overwrite = sys::open(USER_TYPES_PATH, std::ios::out | std::ios::trunc);
             overwrite << "# Configuration file for cliex.\n# It is used by the file explorer to detect file types correctly.\n\n";
             for (const auto &t : user_types)
                 overwrite << t.first << " = " << t.second << "\n";
@@ -74,28 +109,40 @@ std::map<std::string, std::string> cliex::get_all_types()
     return user_types;
 }
 
+static std::string type_by_name(const fs::path &path, fs::perms p, std::map<std::string, std::string> &ftypes)
+{
+    auto it_f = ftypes.find(path.filename().string());
+    auto it_e = ftypes.find(path.extension().string());
+
+    return (it_f != ftypes.end()) ? it_f->second : (it_e != ftypes.end()) ? it_e->second : ((p & fs::perms::owner_exec) != fs::perms::none || (p & fs::perms::group_exec) != fs::perms::none || (p & fs::perms::others_exec) != fs::perms::none) ? "Executable" : "Unknown";
+}
+
 std::string cliex::get_type(fs::path path, fs::perms p, std::map<std::string, std::string> &ftypes)
 {
-    auto filename = path.filename().string();
-    auto extension = path.extension().string();
     std::string type;
 
-    if (fs::is_block_file(path)) type = "block device";
-    else if (fs::is_character_file(path)) type = "character device";
-    else if (fs::is_fifo(path)) type = "named IPC pipe";
-    else if (fs::is_socket(path)) type = "named IPC socket";
-    else if (fs::is_symlink(path)) type = "symlink";
-    else
-    {
-        auto it_f = ftypes.find(filename);
-        auto it_e = ftypes.find(extension);
+    auto &vfs = get_vfs();
 
-        type = (it_f != ftypes.end()) ? it_f->second : (it_e != ftypes.end()) ? it_e->second : ((p & fs::perms::owner_exec) != fs::perms::none || (p & fs::perms::group_exec) != fs::perms::none || (p & fs::perms::others_exec) != fs::perms::none) ? "Executable" : "Unknown";
-    }
+    if (fs::is_block_file(vfs.status(path))) type = "block device";
+    else if (fs::is_character_file(vfs.status(path))) type = "character device";
+    else if (fs::is_fifo(vfs.status(path))) type = "named IPC pipe";
+    else if (fs::is_socket(vfs.status(path))) type = "named IPC socket";
+    else if (fs::is_symlink(vfs.symlink_status(path))) type = "symlink";
+    else type = type_by_name(path, p, ftypes);
 
     return type;
 }
 
+std::string cliex::get_type(fs::path path, fs::file_status status, fs::file_status link, std::map<std::string, std::string> &ftypes)
+{
+    if (fs::is_block_file(status)) return "block device";
+    if (fs::is_character_file(status)) return "character device";
+    if (fs::is_fifo(status)) return "named IPC pipe";
+    if (fs::is_socket(status)) return "named IPC socket";
+    if (fs::is_symlink(link)) return "symlink";
+    return type_by_name(path, status.permissions(), ftypes);
+}
+
 std::string cliex::get_perms(fs::perms p)
 {
     std::string perms_s = "";
@@ -106,12 +153,12 @@ std::string cliex::get_perms(fs::perms p)
 std::map<std::string, std::string> cliex::load_config(std::string file)
 {
     std::map<std::string, std::string> content;
-    std::fstream cf{file, std::ios::in};
+    auto cf = sys::open(file, std::ios::in);
 
     std::string line, value;
     std::vector<std::string> exts;
     int pos_equal;
-    while (std::getline(cf, line))
+    while (sys::read_line(cf, line))
     {
         if (!line.length())
             continue;
@@ -129,39 +176,340 @@ std::map<std::string, std::string> cliex::load_config(std::string file)
     return content;
 }
 
+static void drop_hidden(std::vector<std::string> &v)
+{
+    v.erase(std::remove_if(v.begin(), v.end(), [](const std::string &s)
+    {
+        return s[0] == '.' and s[1] != '.';
+    }),
+    v.end());
+}
+
+static void drop_ignored(const fs::path &dir, std::vector<std::string> &v)
+{
+    auto ignores = cliex::ignore::for_dir(dir.string());
+    if (!ignores)
+        return;
+
+    v.erase(std::remove_if(v.begin(), v.end(), [&ignores](const std::string &s)
+    {
+        bool is_dir = s.back() == '/';
+        return s != ".." && ignores->ignored(std::string_view(s).substr(0, s.size() - is_dir), is_dir);
+    }),
+    v.end());
+}
+
+static fs::filesystem_error cancelled(const fs::path &dir)
+{
+    return fs::filesystem_error("cancelled", dir, std::make_error_code(std::errc::operation_canceled));
+}
+
 void cliex::get_dir_content(
     const char *s, std::vector<std::string> &v,
     fs::path current_dir,
-    std::vector<std::string> &opts)
+    std::vector<std::string> &opts,
+    const cancel_token &cancel)
 
 {
+    perf::scope counters{"get_dir_content"};
     fs::path path(s);
-    fs::directory_iterator beg(path);
-    fs::directory_iterator end;
 
     if (current_dir != ROOT_DIR)
         v.emplace_back("..");
 
-    std::transform(beg, end, std::back_inserter(v), [](const fs::directory_entry &e) -> std::string
+    entry_filter filter{opts};
+    auto &vfs = get_vfs();
+    vfs.list_dir(path, [&v, &vfs, &path, &cancel, &filter](const std::string &name)
     {
-        auto p = e.path();
-        auto status = fs::status(p);
-        std::string s = p.filename().string();
+        if (cancel.cancelled())
+            throw cancelled(path);
+
+        auto verdict = filter.by_name(name.c_str(), DT_UNKNOWN);
+        if (verdict == FILTER_DROP || verdict == FILTER_SKIP)
+            return;
+
+        auto status = vfs.status(path / name);
+        if (verdict == FILTER_STAT && !filter.by_status(path / name, status))
+            return;
+
+        std::string s = name;
         if (fs::is_directory(status))
         {
             s += "/";
         }
-        return s;
+        v.push_back(s);
     });
+}
+
+bool cliex::entry_less(const std::string &a, const std::string &b)
+{
+    if (b == "..")
+        return false;
+    return a == ".." || a < b;
+}
 
-    if (opts[INDEX_ARG_HIDDEN_FILES] == "false")
+static long long elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Reads a directory of the local filesystem without blocking the calling
+ * thread. The entry types come from getdents, only links, entries of
+ * filesystems that don't report a type and entries the filter needs the
+ * metadata of take a statx, and those are submitted together. Entries the
+ * filter drops by their name are never copied.
+*/
+static cliex::aio::task<std::vector<std::string>> read_native_dir(fs::path dir, cliex::cancel_token cancel, cliex::entry_filter filter, struct stat &st)
+{
+    namespace stats = cliex::stats;
+    namespace aio = cliex::aio;
+
+    auto start = std::chrono::steady_clock::now();
+    int dirfd = co_await aio::open(dir.string(), O_RDONLY | O_DIRECTORY);
+    stats::record(stats::CALL_DIR_OPEN, elapsed_ns(start));
+    if (dirfd < 0)
+        throw fs::filesystem_error("cannot open directory", dir, std::error_code(-dirfd, std::generic_category()));
+    if (fstat(dirfd, &st))
+        st = {};
+
+    std::vector<std::string> v;
+    if (dir != ROOT_DIR)
+        v.emplace_back("..");
+
+    std::vector<std::string> untyped;
+    std::vector<size_t> untyped_at;
+    std::vector<unsigned char> untyped_type;
+    std::vector<char> buf(DIRENT_BUFFER_SIZE);
+    int n = 0;
+    while (!cancel.cancelled() && (n = co_await aio::getdents(dirfd, buf.data(), buf.size())) > 0)
+    {
+        for (int off = 0; off < n;)
+        {
+            auto d = reinterpret_cast<const dirent64 *>(buf.data() + off);
+            off += d->d_reclen;
+
+            if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
+                continue;
+            stats::record(stats::CALL_DIR_READ, 0);
+
+            auto verdict = filter.by_name(d->d_name, d->d_type);
+            if (verdict == cliex::FILTER_DROP || verdict == cliex::FILTER_SKIP)
+                continue;
+
+            std::string name = d->d_name;
+            if (d->d_type == DT_DIR)
+            {
+                name += "/";
+            }
+            else if (verdict == cliex::FILTER_STAT || d->d_type == DT_LNK || d->d_type == DT_UNKNOWN)
+            {
+                untyped.push_back(name);
+                untyped_at.push_back(v.size());
+                untyped_type.push_back(d->d_type);
+            }
+            v.push_back(std::move(name));
+        }
+    }
+
+    if (cancel.cancelled())
     {
-        v.erase(std::remove_if(v.begin(), v.end(), [](const std::string &s)
+        co_await aio::close(dirfd);
+        throw cancelled(dir);
+    }
+
+    std::vector<struct statx> attrs;
+    start = std::chrono::steady_clock::now();
+    auto res = co_await aio::statx_all(dirfd, untyped, attrs);
+    bool dropped = false;
+    for (size_t i = 0; i < untyped.size(); i++)
+    {
+        stats::record(stats::CALL_STATUS, elapsed_ns(start) / untyped.size());
+        bool is_dir = res[i] == 0 && S_ISDIR(attrs[i].stx_mode);
+        if (is_dir)
+            v[untyped_at[i]] += "/";
+        if (!filter.active())
+            continue;
+
+        // links to directories are listed as directories, so they are kept
+        // like them
+        bool keep;
+        if (is_dir)
         {
-            return s[0] == '.' and s[1] != '.';
-        }),
-        v.end());
+            keep = filter.by_name(untyped[i].c_str(), DT_DIR) == cliex::FILTER_KEEP;
+        }
+        else
+        {
+            bool regular = res[i] == 0 && S_ISREG(attrs[i].stx_mode);
+            auto type = untyped_type[i] == DT_LNK ? fs::file_type::symlink
+                      : regular ? fs::file_type::regular : fs::file_type::unknown;
+            keep = filter.by_meta(untyped[i].c_str(), type, regular ? attrs[i].stx_size : 0, res[i] == 0 ? attrs[i].stx_mtime.tv_sec : 0);
+        }
+        if (!keep)
+        {
+            v[untyped_at[i]].clear();
+            dropped = true;
+        }
     }
+    if (dropped)
+        v.erase(std::remove(v.begin(), v.end(), std::string()), v.end());
+
+    co_await aio::close(dirfd);
+    if (n < 0)
+        throw fs::filesystem_error("cannot read directory", dir, std::error_code(-n, std::generic_category()));
+    co_return v;
+}
+
+cliex::aio::task<void> cliex::load_listing(std::shared_ptr<listing> l, std::vector<std::string> opts)
+{
+    auto prio = l->speculative ? PRIORITY_PREFETCH : PRIORITY_VISIBLE;
+    try
+    {
+        std::vector<std::string> v;
+        entry_filter filter{opts};
+        if (get_vfs().native())
+        {
+            // another explorer may have listed it already, either in its
+            // current state or through the daemon; those listings are
+            // complete, a filter beyond hidden files reads the directory
+            shm::key key;
+            bool shared = false;
+            bool reuse = !filter.active();
+            if (reuse && shm::enabled())
+            {
+                struct statx attr;
+                auto path = l->dir.string();
+                auto start = std::chrono::steady_clock::now();
+                int res = co_await aio::statx(AT_FDCWD, path, &attr);
+                stats::record(stats::CALL_STATUS, elapsed_ns(start));
+                if (res == 0)
+                {
+                    key = {makedev(attr.stx_dev_major, attr.stx_dev_minor), attr.stx_ino, attr.stx_mtime.tv_sec * 1000000000LL + attr.stx_mtime.tv_nsec};
+                    shared = co_await aio::offload([&key, &v]
+                    {
+                        return shm::find(key, v);
+                    }, prio);
+                }
+            }
+
+            bool fetched = shared || (reuse && daemon::available() && co_await aio::offload([&l, &v]
+            {
+                return daemon::fetch(l->dir, v);
+            }, prio));
+            struct stat st = {};
+            if (shared)
+            {
+                st.st_dev = key.dev;
+                st.st_ino = key.ino;
+            }
+            if (!fetched)
+                v = co_await read_native_dir(l->dir, l->cancel, filter, st);
+
+            // the path was swapped for another directory after the cache
+            // watched it
+            if (st.st_ino && l->ino && (st.st_dev != l->dev || st.st_ino != l->ino))
+                throw fs::filesystem_error("directory was replaced", l->dir, std::error_code(ESTALE, std::generic_category()));
+            if (st.st_ino)
+            {
+                l->dev = st.st_dev;
+                l->ino = st.st_ino;
+            }
+
+            if (key.ino && !shared && (fetched || filter.keeps_all()))
+            {
+                co_await aio::offload([&key, &v]
+                {
+                    shm::publish(key, v);
+                }, prio);
+            }
+            if (fetched && !filter.keeps_all())
+                drop_hidden(v);
+            if (opts[INDEX_ARG_HIDE_IGNORED] == "true")
+            {
+                co_await aio::offload([&l, &v]
+                {
+                    drop_ignored(l->dir, v);
+                }, prio);
+            }
+        }
+        else
+        {
+            v = co_await aio::offload([&l, &opts]
+            {
+                pool::io_slot io;
+                std::vector<std::string> v;
+                if (!fs::is_directory(get_vfs().status(l->dir)))
+                    throw fs::filesystem_error("not a directory", l->dir, std::make_error_code(std::errc::not_a_directory));
+
+                get_dir_content(l->dir.string().c_str(), v, l->dir, opts, l->cancel);
+                return v;
+            }, prio);
+        }
+
+        // the continuation runs on the main thread, keep the bulk work off it
+        co_await aio::offload([&l, &v]
+        {
+            {
+                perf::scope counters{"sort"};
+                std::sort(v.begin(), v.end(), entry_less);
+            }
+
+            perf::scope counters{"display_width"};
+            l->widths.reserve(v.size());
+            for (const auto &name : v)
+                l->widths.push_back(display_width(name));
+        }, prio);
+        l->entries.swap(v);
+    }
+    catch (const fs::filesystem_error &e)
+    {
+        l->error = e.what();
+    }
+    l->done = true;
+}
+
+/*
+ * The chunks of the listing are evaluated in parallel, each one collects the
+ * indexes that match; the listing is sorted already, so is the result.
+*/
+static cliex::aio::task<void> run_query(std::shared_ptr<cliex::listing> l, std::shared_ptr<const cliex::listing> from, std::shared_ptr<const cliex::query> q)
+{
+    using namespace cliex;
+    try
+    {
+        size_t count = from->entries.size();
+        std::vector<std::vector<size_t>> found((count + QUERY_CHUNK_SIZE - 1) / QUERY_CHUNK_SIZE);
+        co_await aio::parallel(found.size(), [&from, &q, &found, count](size_t i)
+        {
+            perf::scope counters{"query"};
+            q->select(*from, i * QUERY_CHUNK_SIZE, std::min(count, (i + 1) * QUERY_CHUNK_SIZE), found[i]);
+        });
+
+        co_await aio::offload([&l, &from, &found]
+        {
+            for (const auto &chunk : found)
+            {
+                for (size_t i : chunk)
+                {
+                    l->entries.push_back(from->entries[i]);
+                    l->widths.push_back(from->widths[i]);
+                }
+            }
+        });
+    }
+    catch (const fs::filesystem_error &e)
+    {
+        l->error = e.what();
+    }
+    l->done = true;
+}
+
+std::shared_ptr<cliex::listing> cliex::query_listing(std::shared_ptr<const listing> from, std::shared_ptr<const query> q)
+{
+    auto l = std::make_shared<listing>();
+    l->dir = from->dir;
+    aio::spawn(run_query(l, std::move(from), std::move(q)));
+    return l;
 }
 
 WINDOW* cliex::add_win(int height, int width, int starty, int startx, const char *title = "")
@@ -175,70 +523,102 @@ WINDOW* cliex::add_win(int height, int width, int starty, int startx, const char
     return win;
 }
 
-MENU* cliex::add_file_menu(
-    WINDOW *win, std::vector<std::string> &choices,
-    std::vector<ITEM *> &items,
-    fs::path current_dir,
-    std::vector<std::string> &opts)
-
+static void draw_title(WINDOW *win, const fs::path &current_dir)
 {
     std::string current_dir_s = current_dir.string();
-    unsigned longest = 0;
-    int max_columns;
 
-    std::transform(choices.begin(), choices.end(), std::back_inserter(items), [](const std::string &s) -> ITEM * { return new_item(s.c_str(), ""); });
-    items.emplace_back(nullptr);
+    wmove(win, 1, 18);
+    wclrtoeol(win);
+    wattron(win, A_BOLD);
+    mvwaddstr(win, 1, MAIN_WIDTH - cliex::display_width(current_dir_s) - 2, current_dir_s.c_str());
+    wattroff(win, A_BOLD);
+    box(win, 0, 0);
+}
 
-    MENU *menu = new_menu(const_cast<ITEM **>(items.data()));
-    set_menu_win(menu, win);
-    set_menu_sub(menu, derwin(win, SUB_HEIGHT, SUB_WIDTH, 3, 3));
+void cliex::show_dir(
+    WINDOW *win, file_grid &grid,
+    std::vector<std::string> &choices,
+    std::vector<unsigned short> &widths,
+    fs::path current_dir,
+    std::vector<std::string> &opts)
 
-    for (auto &c : choices)
-    {
-        if (c.length() > longest)
-            longest = c.length();
-    }
+{
+    perf::scope counters{"layout"};
+    unsigned max_columns;
 
     try
     {
-        max_columns = std::stoi(opts[INDEX_ARG_MAX_COLUMNS]);
+        max_columns = std::max(1, std::stoi(opts[INDEX_ARG_MAX_COLUMNS]));
     }
     catch (...)
     {
-        max_columns = SUB_WIDTH / longest;
+        max_columns = UINT_MAX;
     }
 
-    set_menu_format(menu, LINES - 5, max_columns < SUB_WIDTH / longest ? max_columns : SUB_WIDTH / longest);
-    set_menu_mark(menu, "");
+    if (!grid.window())
+        grid.place(win, SUB_HEIGHT, SUB_WIDTH, 3, 3);
+    grid.assign(&choices, &widths, max_columns);
+    grid.draw();
+    draw_title(win, current_dir);
+}
+
+void cliex::show_tree(WINDOW *win, tree_view &tree, std::shared_ptr<listing> l)
+{
+    perf::scope counters{"layout"};
 
-    wmove(win, 1, 18);
-    wclrtoeol(win);
-    wattron(win, A_BOLD);
-    mvwaddstr(win, 1, MAIN_WIDTH - current_dir_s.length() - 2, current_dir_s.c_str());
-    wattroff(win, A_BOLD);
+    fs::path dir = l->dir;
+    tree.assign(std::move(l));
+    tree.draw();
+    draw_title(win, dir);
+}
+
+void cliex::reflow(WINDOW *win, file_grid &grid, fs::path current_dir)
+{
+    perf::scope counters{"layout"};
+
+    grid.reflow();
+    grid.draw();
+    draw_title(win, current_dir);
+}
+
+void cliex::reflow(WINDOW *win, tree_view &tree, fs::path current_dir)
+{
+    perf::scope counters{"layout"};
 
-    post_menu(menu);
-    return menu;
+    tree.reflow();
+    tree.draw();
+    draw_title(win, current_dir);
 }
 
-void cliex::clear_menu(MENU *menu, std::vector<ITEM *> &items)
+void cliex::show_error(WINDOW *property_win, const std::string &message)
 {
-    unpost_menu(menu);
-    free_menu(menu);
-    for (auto &it : items)
-        free_item(it);
+    for (int y = 3; y <= 9; y++)
+    {
+        wmove(property_win, y, 3);
+        wclrtoeol(property_win);
+    }
+    mvwaddnstr(property_win, 3, 3, ("Error: " + message).c_str(), getmaxx(property_win) - 4);
+    box(property_win, 0, 0);
+    frame::touch(property_win);
 }
 
 void cliex::show_file_info(WINDOW *property_win,
                            std::string &selected,
                            fs::path full_path,
-                           std::map<std::string, std::string> &ftypes)
+                           std::map<std::string, std::string> &ftypes,
+                           timestamp::style time_style)
 {
     using std::make_pair;
     using namespace std::chrono_literals;
 
-    auto status = fs::status(full_path);
-    auto is_dir = fs::is_directory(status);
+    perf::scope counters{"show_file_info"};
+
+    auto d = info::get(full_path);
+    if (d && !d->error.empty())
+    {
+        show_error(property_win, d->error);
+        return;
+    }
 
     std::vector<std::string> units
     {
@@ -250,7 +630,8 @@ void cliex::show_file_info(WINDOW *property_win,
         make_pair(4, 3),
         make_pair(6, 3),
         make_pair(7, 3),
-        make_pair(8, 3)};
+        make_pair(8, 3),
+        make_pair(9, 3)};
 
     for (auto &p : line_pos)
     {
@@ -258,12 +639,25 @@ void cliex::show_file_info(WINDOW *property_win,
         wclrtoeol(property_win);
     }
 
-    mvwaddstr(property_win, 3, 3, selected.c_str());
-    mvwaddstr(property_win, 4, 3, ("Type: "s + (is_dir ? "directory" : get_type(full_path, status.permissions(), ftypes))).c_str());
+    mvwaddnstr(property_win, 3, 3, selected.c_str(), display_prefix(selected, getmaxx(property_win) - 4));
+
+    // the labels until the metadata was read
+    if (!d)
+    {
+        mvwaddstr(property_win, 4, 3, "Type: ...");
+        mvwaddstr(property_win, 7, 3, "Permissions: ...");
+        mvwaddstr(property_win, 8, 3, "Owner: ...");
+        mvwaddstr(property_win, 9, 3, "Last mod.: ...");
+        frame::touch(property_win);
+        return;
+    }
+
+    auto is_dir = fs::is_directory(d->status);
+    mvwaddstr(property_win, 4, 3, ("Type: "s + (is_dir ? "directory" : get_type(full_path, d->status, d->link, ftypes))).c_str());
 
     if (!is_dir)
     {
-        size_t size = fs::file_size(full_path);
+        size_t size = d->size;
         for (int i = 0;; i++)
         {
             if (size < 1024)
@@ -275,11 +669,34 @@ void cliex::show_file_info(WINDOW *property_win,
         }
     }
 
-    mvwaddstr(property_win, 7, 3, ("Permissions: "s + get_perms(status.permissions())).c_str());
+    mvwaddstr(property_win, 7, 3, ("Permissions: "s + get_perms(d->status.permissions())).c_str());
+
+    // numbers until the names were looked up
+    mvwaddstr(property_win, 8, 3, ("Owner: " + owners::user(d->owner.uid) + ":" + owners::group(d->owner.gid)).c_str());
+
+    char mtime[TIMESTAMP_SIZE];
+    timestamp::format(d->mtime, time_style, mtime);
+    mvwaddnstr(property_win, 9, 3, ("Last mod.: "s + mtime).c_str(), getmaxx(property_win) - 4);
+
+    frame::touch(property_win);
+}
+
+cliex::stats::footprint cliex::get_footprint(std::vector<std::string> &choices,
+        std::vector<unsigned short> &widths,
+        file_grid &grid,
+        std::map<std::string, std::string> &ftypes)
+{
+    stats::footprint f;
+
+    f.entries = choices.size();
+    f.names = choices.capacity() * sizeof(std::string);
+    for (const auto &c : choices)
+        f.names += heap_size(c);
+    f.widths = widths.capacity() * sizeof(widths[0]);
+    f.layout = grid.memory();
 
-    auto ftime = fs::last_write_time(full_path);
-    std::time_t cftime = decltype(ftime)::clock::to_time_t(ftime);
-    mvwaddstr(property_win, 8, 3, ("Last mod.: "s + std::asctime(std::localtime(&cftime))).c_str());
+    for (const auto &t : ftypes)
+        f.types += sizeof(t) + 4 * sizeof(void *) + MALLOC_OVERHEAD + heap_size(t.first) + heap_size(t.second);
 
-    wrefresh(property_win);
+    return f;
 }
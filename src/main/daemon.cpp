@@ -0,0 +1,489 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * daemon.cpp
+ *
+ * The protocol: a request is a request_header followed by an absolute path,
+ * the directory's descriptor travels as SCM_RIGHTS with it. The reply is a
+ * reply_header followed by the entries, each ending with a NUL. One request
+ * per connection.
+ *
+ * Listings are shared by path, and a client may point the path somewhere
+ * else once its descriptor was checked. A listing is only sent when it read
+ * the directory of that descriptor, so nobody gets one they couldn't open.
+ *
+ * The daemon's main thread only accepts and looks listings up; reading a
+ * request and writing a reply block on a client, so they run on the pool,
+ * with timeouts.
+*/
+
+#include <iostream>
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <atomic>
+#include <chrono>
+
+#include <experimental/filesystem>
+
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "daemon.hpp"
+#include "cliex.hpp"
+#include "cache.hpp"
+#include "vfs.hpp"
+#include "aio.hpp"
+#include "pool.hpp"
+
+#define DAEMON_MAGIC 0x44584c43
+#define DAEMON_VERSION 1
+#define DAEMON_OP_LIST 1
+
+namespace
+{
+struct request_header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t op;
+    uint32_t path_length;
+};
+
+struct reply_header
+{
+    uint32_t magic;
+    uint16_t version;
+    // an errno value, or EIO if the daemon couldn't list the directory
+    uint16_t error;
+    uint32_t count;
+    uint32_t length;
+};
+
+std::string socket_path;
+std::atomic<long long> retry_at{0};
+volatile sig_atomic_t stopping = 0;
+
+long long now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void set_timeouts(int fd)
+{
+    timeval tv;
+    tv.tv_sec = DAEMON_TIMEOUT_MS / 1000;
+    tv.tv_usec = DAEMON_TIMEOUT_MS % 1000 * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+}
+
+bool read_all(int fd, void *buf, size_t n)
+{
+    auto p = static_cast<char *>(buf);
+    while (n)
+    {
+        auto r = recv(fd, p, n, 0);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+bool write_all(int fd, const void *buf, size_t n)
+{
+    auto p = static_cast<const char *>(buf);
+    while (n)
+    {
+        auto r = send(fd, p, n, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+bool make_address(const std::string &path, sockaddr_un &addr)
+{
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof addr.sun_path)
+        return false;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int connect_to(const std::string &path)
+{
+    sockaddr_un addr;
+    if (!make_address(path, addr))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct request
+{
+    std::string dir;
+    // the directory of the client's descriptor
+    dev_t dev = 0;
+    ino_t ino = 0;
+    int error = 0;
+};
+
+// reads the request and checks that its descriptor is the directory it names
+request read_request(int fd)
+{
+    request req;
+    request_header h;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    iovec iov = {&h, sizeof h};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+
+    ssize_t n;
+    while ((n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR)
+    {
+    }
+
+    int dirfd = -1;
+    for (auto c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+    {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i++)
+        {
+            int received;
+            memcpy(&received, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+            if (dirfd < 0)
+                dirfd = received;
+            else
+                close(received);
+        }
+    }
+
+    bool complete = n > 0 && (static_cast<size_t>(n) == sizeof h || read_all(fd, reinterpret_cast<char *>(&h) + n, sizeof h - n));
+    if (!complete || h.magic != DAEMON_MAGIC || h.version != DAEMON_VERSION || h.op != DAEMON_OP_LIST || !h.path_length || h.path_length > PATH_MAX)
+        req.error = EPROTO;
+    else
+    {
+        req.dir.resize(h.path_length);
+        if (!read_all(fd, req.dir.data(), h.path_length) || req.dir[0] != '/' || req.dir.find('\0') != std::string::npos)
+            req.error = EPROTO;
+    }
+
+    struct stat named, given;
+    if (!req.error && dirfd < 0)
+        req.error = EBADF;
+    else if (!req.error && (fstat(dirfd, &given) || stat(req.dir.c_str(), &named)))
+        req.error = errno;
+    else if (!req.error && (!S_ISDIR(given.st_mode) || given.st_dev != named.st_dev || given.st_ino != named.st_ino))
+        req.error = EACCES;
+    else if (!req.error)
+    {
+        req.dev = given.st_dev;
+        req.ino = given.st_ino;
+    }
+
+    if (dirfd >= 0)
+        close(dirfd);
+    return req;
+}
+
+std::vector<char> make_reply(const cliex::listing *l, int error)
+{
+    reply_header h = {DAEMON_MAGIC, DAEMON_VERSION, static_cast<uint16_t>(error), 0, 0};
+    if (l && !l->error.empty())
+        h.error = EIO;
+
+    size_t length = 0;
+    if (l && !h.error)
+    {
+        for (const auto &name : l->entries)
+            length += name.size() + 1;
+        if (length > DAEMON_MAX_REPLY)
+            h.error = EFBIG;
+    }
+
+    std::vector<char> out(sizeof h);
+    if (l && !h.error)
+    {
+        h.count = l->entries.size();
+        h.length = length;
+        out.reserve(sizeof h + length);
+        for (const auto &name : l->entries)
+            out.insert(out.end(), name.c_str(), name.c_str() + name.size() + 1);
+    }
+    memcpy(out.data(), &h, sizeof h);
+    return out;
+}
+
+// a client whose listing is still loading
+struct waiting
+{
+    int fd;
+    std::shared_ptr<cliex::listing> listing;
+    dev_t dev;
+    ino_t ino;
+};
+
+std::vector<waiting> queue;
+
+void send_reply(int fd, std::vector<char> reply)
+{
+    cliex::pool::submit([fd, reply = std::move(reply)]
+    {
+        write_all(fd, reply.data(), reply.size());
+        close(fd);
+    }, cliex::PRIORITY_VISIBLE);
+}
+
+cliex::aio::task<void> serve_client(int fd)
+{
+    auto req = co_await cliex::aio::offload([fd]
+    {
+        return read_request(fd);
+    });
+
+    if (req.error)
+    {
+        send_reply(fd, make_reply(nullptr, req.error));
+        co_return;
+    }
+
+    // the daemon's listings always include hidden files, clients drop them
+    static const std::vector<std::string> opts(INDEX_ARG_COUNT);
+    queue.push_back({fd, cliex::cache::get(req.dir, opts), req.dev, req.ino});
+}
+
+void reply_done()
+{
+    for (size_t i = 0; i < queue.size();)
+    {
+        if (!queue[i].listing->done)
+        {
+            i++;
+            continue;
+        }
+
+        const auto &w = queue[i];
+        bool same = w.listing->dev == w.dev && w.listing->ino == w.ino;
+        send_reply(w.fd, same ? make_reply(w.listing.get(), 0) : make_reply(nullptr, EACCES));
+        queue[i] = std::move(queue.back());
+        queue.pop_back();
+    }
+}
+
+void on_stop(int)
+{
+    stopping = 1;
+    cliex::aio::notify();
+}
+
+int listen_on(const std::string &path)
+{
+    sockaddr_un addr;
+    if (!make_address(path, addr))
+    {
+        std::cerr << "cliex: socket path too long: " << path << "\n";
+        return -1;
+    }
+
+    int other = connect_to(path);
+    if (other >= 0)
+    {
+        close(other);
+        std::cerr << "cliex: a daemon is already listening on " << path << "\n";
+        return -1;
+    }
+
+    // a socket nobody listens on is left over from a daemon that died
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) || chmod(path.c_str(), 0666) || listen(fd, SOMAXCONN))
+    {
+        std::cerr << "cliex: cannot listen on " << path << ": " << strerror(errno) << "\n";
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+}
+
+int cliex::daemon::serve(const std::string &path)
+{
+    if (!get_vfs().native())
+    {
+        std::cerr << "cliex: the daemon only serves the local filesystem\n";
+        return 1;
+    }
+
+    int fd = listen_on(path);
+    if (fd < 0)
+        return 1;
+
+    struct sigaction sa = {};
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = on_stop;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    cache::limit(DAEMON_MAX_LISTINGS);
+
+    while (!stopping)
+    {
+        if (aio::wait(fd))
+        {
+            int client;
+            while ((client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC)) >= 0)
+            {
+                set_timeouts(client);
+                aio::spawn(serve_client(client));
+            }
+        }
+        reply_done();
+    }
+
+    close(fd);
+    unlink(path.c_str());
+    return 0;
+}
+
+void cliex::daemon::use(const std::string &path)
+{
+    socket_path = path;
+}
+
+bool cliex::daemon::available()
+{
+    return !socket_path.empty() && now_ms() >= retry_at;
+}
+
+bool cliex::daemon::fetch(const fs::path &dir, std::vector<std::string> &v)
+{
+    auto path = dir.string();
+    if (socket_path.empty() || path.empty() || path[0] != '/' || path.size() > PATH_MAX)
+        return false;
+
+    int dirfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+        return false;
+
+    int fd = connect_to(socket_path);
+    ucred peer;
+    socklen_t peer_length = sizeof peer;
+    if (fd >= 0 && (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &peer_length) || (peer.uid != 0 && peer.uid != getuid())))
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0)
+    {
+        close(dirfd);
+        retry_at = now_ms() + DAEMON_RETRY_MS;
+        return false;
+    }
+    set_timeouts(fd);
+
+    request_header h = {DAEMON_MAGIC, DAEMON_VERSION, DAEMON_OP_LIST, static_cast<uint32_t>(path.size())};
+    std::string message(reinterpret_cast<const char *>(&h), sizeof h);
+    message += path;
+    iovec iov = {message.data(), message.size()};
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    auto c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &dirfd, sizeof(int));
+
+    ssize_t sent;
+    while ((sent = sendmsg(fd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+    {
+    }
+    close(dirfd);
+
+    // the descriptor went with the first byte, a short write only needs the rest
+    bool ok = sent >= 0 && write_all(fd, message.data() + sent, message.size() - sent);
+
+    reply_header r;
+    std::vector<char> body;
+    ok = ok && read_all(fd, &r, sizeof r) && r.magic == DAEMON_MAGIC && r.version == DAEMON_VERSION && !r.error && r.length <= DAEMON_MAX_REPLY;
+    if (ok)
+    {
+        body.resize(r.length);
+        ok = read_all(fd, body.data(), body.size()) && (body.empty() || body.back() == '\0');
+    }
+    close(fd);
+    if (!ok)
+        return false;
+
+    std::vector<std::string> entries;
+    entries.reserve(r.count);
+    for (size_t off = 0; off < body.size();)
+    {
+        size_t end = off + strlen(body.data() + off);
+        entries.emplace_back(body.data() + off, end - off);
+        off = end + 1;
+    }
+    if (entries.size() != r.count)
+        return false;
+
+    v.swap(entries);
+    return true;
+}
@@ -0,0 +1,215 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * filter.cpp
+ *
+ * The checks run from the cheapest to the most expensive: the hidden flag
+ * and the type from getdents, then the name, then whatever needs a stat.
+*/
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <chrono>
+
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+
+#include "filter.hpp"
+#include "cliex.hpp"
+#include "vfs.hpp"
+
+namespace
+{
+// 0 where getdents doesn't tell; links count as what they point to
+unsigned kind_of(unsigned char d_type)
+{
+    switch (d_type)
+    {
+    case DT_REG:
+        return cliex::FILTER_FILE;
+    case DT_DIR:
+        return cliex::FILTER_DIR;
+    case DT_UNKNOWN:
+    case DT_LNK:
+        return 0;
+    default:
+        return cliex::FILTER_OTHER;
+    }
+}
+
+unsigned kind_of(fs::file_type t)
+{
+    switch (t)
+    {
+    case fs::file_type::regular:
+        return cliex::FILTER_FILE;
+    case fs::file_type::directory:
+        return cliex::FILTER_DIR;
+    case fs::file_type::symlink:
+        return cliex::FILTER_LINK;
+    default:
+        return cliex::FILTER_OTHER;
+    }
+}
+
+// a number with one of the given unit letters, each worth the factor
+// at the same place
+long long parse_scaled(const std::string &s, const char *units, const long long *factors, const char *what)
+{
+    size_t end = 0;
+    double n;
+    try
+    {
+        n = std::stod(s, &end);
+    }
+    catch (const std::logic_error&)
+    {
+        throw std::invalid_argument("invalid " + std::string(what) + " " + s);
+    }
+
+    long long factor = 1;
+    if (end < s.size())
+    {
+        auto unit = strchr(units, s[end] | 0x20);
+        if (!unit || !*unit || end + 1 != s.size())
+            throw std::invalid_argument("invalid " + std::string(what) + " " + s);
+        factor = factors[unit - units];
+    }
+    if (n < 0)
+        throw std::invalid_argument("invalid " + std::string(what) + " " + s);
+    return static_cast<long long>(n * factor);
+}
+}
+
+long long cliex::parse_size(const std::string &s)
+{
+    static const long long factors[] = {1, 1LL << 10, 1LL << 20, 1LL << 30, 1LL << 40};
+    return parse_scaled(s, "bkmgt", factors, "size");
+}
+
+long long cliex::parse_age(const std::string &s)
+{
+    static const long long factors[] = {1, 60, 3600, 86400, 7 * 86400};
+    return parse_scaled(s, "smhdw", factors, "age");
+}
+
+cliex::entry_filter::entry_filter(const std::vector<std::string> &opts)
+{
+    hidden = opts[INDEX_ARG_HIDDEN_FILES] != "false";
+
+    const auto &types = opts[INDEX_ARG_TYPE];
+    if (!types.empty())
+    {
+        kinds = 0;
+        size_t pos = 0;
+        while (pos <= types.size())
+        {
+            size_t comma = std::min(types.find(',', pos), types.size());
+            auto t = types.substr(pos, comma - pos);
+            if (t == "file")
+                kinds |= FILTER_FILE;
+            else if (t == "dir")
+                kinds |= FILTER_DIR;
+            else if (t == "symlink")
+                kinds |= FILTER_LINK;
+            else if (t == "other")
+                kinds |= FILTER_OTHER;
+            else
+                throw std::invalid_argument("unknown type " + t + ", use file, dir, symlink or other");
+            pos = comma + 1;
+        }
+    }
+
+    if (!opts[INDEX_ARG_NAME].empty())
+    {
+        named = true;
+        name = glob(opts[INDEX_ARG_NAME]);
+    }
+    if (!opts[INDEX_ARG_MIN_SIZE].empty())
+        min_size = parse_size(opts[INDEX_ARG_MIN_SIZE]);
+    if (!opts[INDEX_ARG_MAX_SIZE].empty())
+        max_size = parse_size(opts[INDEX_ARG_MAX_SIZE]);
+
+    long long now = time(nullptr);
+    if (!opts[INDEX_ARG_NEWER].empty())
+        newer = now - parse_age(opts[INDEX_ARG_NEWER]);
+    if (!opts[INDEX_ARG_OLDER].empty())
+        older = now - parse_age(opts[INDEX_ARG_OLDER]);
+}
+
+bool cliex::entry_filter::active() const
+{
+    return kinds != FILTER_ALL || named || needs_meta();
+}
+
+cliex::filter_verdict cliex::entry_filter::by_name(const char *n, unsigned char d_type) const
+{
+    if (n[0] == '.' && (!n[1] || (n[1] == '.' && !n[2])))
+        return FILTER_KEEP;
+    if (!hidden && n[0] == '.')
+        return FILTER_DROP;
+
+    unsigned kind = kind_of(d_type);
+    if (kind == FILTER_DIR)
+        return kinds & FILTER_DIR ? FILTER_KEEP : FILTER_SKIP;
+    // it may still turn out to be a directory
+    if (!kind)
+        return active() ? FILTER_STAT : FILTER_KEEP;
+    if (!(kinds & kind) || (named && !name.match(n)))
+        return FILTER_DROP;
+    return needs_meta() ? FILTER_STAT : FILTER_KEEP;
+}
+
+bool cliex::entry_filter::by_meta(const char *n, fs::file_type type, unsigned long long size, long long mtime) const
+{
+    if (!(kinds & kind_of(type)) || (named && !name.match(n)))
+        return false;
+
+    if (min_size >= 0 && size < static_cast<unsigned long long>(min_size))
+        return false;
+    if (max_size >= 0 && size > static_cast<unsigned long long>(max_size))
+        return false;
+    return mtime >= newer && mtime <= older;
+}
+
+bool cliex::entry_filter::by_status(const fs::path &p, const fs::file_status &status) const
+{
+    auto name = p.filename().string();
+    if (fs::is_directory(status))
+        return by_name(name.c_str(), DT_DIR) == FILTER_KEEP;
+
+    try
+    {
+        auto &vfs = get_vfs();
+        unsigned long long size = 0;
+        long long mtime = 0;
+        if (needs_meta() && fs::exists(status))
+        {
+            size = fs::is_regular_file(status) ? vfs.file_size(p) : 0;
+            mtime = std::chrono::duration_cast<std::chrono::seconds>(vfs.last_write_time(p).time_since_epoch()).count();
+        }
+        return by_meta(name.c_str(), vfs.symlink_status(p).type(), size, mtime);
+    }
+    catch (const fs::filesystem_error&)
+    {
+        return false;
+    }
+}
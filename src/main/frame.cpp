@@ -0,0 +1,130 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * frame.cpp
+ *
+ * The synchronized output sequences are written straight to the terminal:
+ * ncurses has flushed everything before doupdate returns, and before it
+ * starts there is nothing buffered, so they always end up around the frame.
+*/
+
+#include <string>
+
+#include <vector>
+#include <algorithm>
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <ncurses.h>
+#include <term.h>
+
+#include "frame.hpp"
+
+#define SYNC_BEGIN "\033[?2026h"
+#define SYNC_END "\033[?2026l"
+
+namespace
+{
+int out_fd = -1;
+std::string sync_begin, sync_end;
+std::vector<WINDOW *> dirty;
+unsigned long presented = 0;
+
+void write_all(const std::string &s)
+{
+    size_t done = 0;
+    while (done < s.size())
+    {
+        ssize_t n = write(out_fd, s.data() + done, s.size() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        done += n;
+    }
+}
+}
+
+void cliex::frame::init(int fd, const std::string &sync)
+{
+    out_fd = fd;
+    sync_begin.clear();
+    sync_end.clear();
+
+    if (sync == "true")
+    {
+        sync_begin = SYNC_BEGIN;
+        sync_end = SYNC_END;
+    }
+    else if (sync != "false")
+    {
+        // the extended capability takes 1 to begin and 2 to end a frame
+        char *cap = tigetstr(const_cast<char *>("Sync"));
+        if (cap && cap != reinterpret_cast<char *>(-1))
+        {
+            sync_begin = tiparm(cap, 1);
+            sync_end = tiparm(cap, 2);
+        }
+    }
+}
+
+bool cliex::frame::synchronized()
+{
+    return !sync_begin.empty();
+}
+
+void cliex::frame::touch(WINDOW *win)
+{
+    if (std::find(dirty.begin(), dirty.end(), win) == dirty.end())
+        dirty.push_back(win);
+}
+
+void cliex::frame::forget(WINDOW *win)
+{
+    dirty.erase(std::remove(dirty.begin(), dirty.end(), win), dirty.end());
+}
+
+void cliex::frame::present()
+{
+    if (dirty.empty())
+        return;
+
+    // the other windows lie on top of stdscr
+    auto it = std::find(dirty.begin(), dirty.end(), stdscr);
+    if (it != dirty.end())
+        std::rotate(dirty.begin(), it, it + 1);
+
+    for (auto win : dirty)
+        wnoutrefresh(win);
+    dirty.clear();
+
+    if (synchronized() && out_fd >= 0)
+        write_all(sync_begin);
+    doupdate();
+    if (synchronized() && out_fd >= 0)
+        write_all(sync_end);
+
+    presented++;
+}
+
+unsigned long cliex::frame::frames()
+{
+    return presented;
+}
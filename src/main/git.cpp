@@ -0,0 +1,563 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * git.cpp
+ *
+ * The index is mapped and parsed once per repository and parsed again when
+ * its own stat data changes. Its entries are sorted by path, so the entries
+ * of a directory are one range and a subdirectory is skipped with a single
+ * lower_bound, only the files directly inside the shown directory are
+ * stat'ed.
+ *
+ * Whether an entry is untracked or ignored is decided when it is drawn,
+ * which keeps the marks right for entries that appear after the index was
+ * compared.
+*/
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <algorithm>
+
+#include <memory>
+#include <utility>
+#include <mutex>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "git.hpp"
+#include "ignore.hpp"
+#include "vfs.hpp"
+#include "aio.hpp"
+#include "stats.hpp"
+
+#define INDEX_SIGNATURE 0x44495243
+#define INDEX_ASSUME_VALID 0x8000
+#define INDEX_EXTENDED 0x4000
+#define INDEX_STAGE 0x3000
+#define INDEX_NAME_MASK 0x0fff
+#define INDEX_SKIP_WORKTREE 0x40000000
+
+namespace
+{
+struct index_entry
+{
+    uint32_t path;
+    uint32_t len;
+    uint32_t ctime;
+    uint32_t ctime_nsec;
+    uint32_t mtime;
+    uint32_t mtime_nsec;
+    uint32_t ino;
+    uint32_t mode;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t size;
+    uint32_t flags;
+};
+
+struct index
+{
+    struct stat st;
+    std::string paths;
+    std::vector<index_entry> entries;
+
+    std::string_view path(const index_entry &e) const
+    {
+        return {paths.data() + e.path, e.len};
+    }
+};
+
+struct status
+{
+    bool repository = false;
+    // the shown directory, relative to the work tree, empty or ending in '/'
+    std::string rel;
+    std::unordered_set<std::string> tracked;
+    std::unordered_set<std::string> modified;
+    // unchanged stat data that can't be trusted, neither clean nor modified
+    std::unordered_set<std::string> racy;
+    std::unordered_set<std::string> unmerged;
+    std::shared_ptr<const cliex::ignore::matcher> ignores;
+};
+
+struct dir_state
+{
+    std::shared_ptr<const status> marks;
+    bool running = false;
+    bool again = false;
+    unsigned long used = 0;
+};
+
+std::mutex index_mtx;
+std::unordered_map<std::string, std::shared_ptr<const index>> indexes;
+
+std::unordered_map<std::string, dir_state> dirs;
+unsigned long last_use = 0;
+bool arrived = false;
+
+uint32_t be32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+    return ntohl(v);
+}
+
+uint16_t be16(const unsigned char *p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof v);
+    return ntohs(v);
+}
+
+bool read_file(const std::string &path, std::string &out)
+{
+    int fd;
+    {
+        cliex::stats::timer t{cliex::stats::CALL_OPEN};
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0)
+        return false;
+
+    cliex::stats::timer t{cliex::stats::CALL_READ};
+    out.clear();
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+        out.append(buf, n);
+    ::close(fd);
+    return n == 0;
+}
+
+// the git directory of the work tree at top, empty if there is none
+std::string find_gitdir(const std::string &top)
+{
+    auto dot = top + (top == "/" ? ".git" : "/.git");
+    struct stat st;
+    {
+        cliex::stats::timer t{cliex::stats::CALL_SYMLINK_STATUS};
+        if (::stat(dot.c_str(), &st))
+            return {};
+    }
+    if (S_ISDIR(st.st_mode))
+        return dot;
+    if (!S_ISREG(st.st_mode))
+        return {};
+
+    // a linked work tree or submodule points to its git directory
+    std::string content;
+    if (!read_file(dot, content) || content.compare(0, 8, "gitdir: "))
+        return {};
+    auto gitdir = content.substr(8, content.find_first_of("\r\n") - 8);
+    if (gitdir.empty())
+        return {};
+    return gitdir[0] == '/' ? gitdir : top + "/" + gitdir;
+}
+
+size_t hash_size(const std::string &gitdir)
+{
+    std::string config;
+    if (!read_file(gitdir + "/config", config))
+        return 20;
+    auto at = config.find("objectformat");
+    return at != std::string::npos && config.find("sha256", at) != std::string::npos ? 32 : 20;
+}
+
+// git's offset encoding of the bytes a v4 path drops from its predecessor
+bool varint(const unsigned char *&p, const unsigned char *end, size_t &v)
+{
+    if (p >= end)
+        return false;
+    unsigned char c = *p++;
+    v = c & 127;
+    while (c & 128)
+    {
+        if (p >= end)
+            return false;
+        c = *p++;
+        v = ((v + 1) << 7) | (c & 127);
+    }
+    return true;
+}
+
+bool parse_index(const unsigned char *data, size_t size, size_t hash, index &idx)
+{
+    if (size < 12 + hash || be32(data) != INDEX_SIGNATURE)
+        return false;
+    uint32_t version = be32(data + 4);
+    if (version < 2 || version > 4)
+        return false;
+    uint32_t count = be32(data + 8);
+
+    // ten 32-bit stat fields, the object id and the flags; a count that
+    // can't fit is a corrupt index, not a reason to reserve gigabytes
+    const size_t fixed = 40 + hash + 2;
+    if (count > (size - 12 - hash) / fixed)
+        return false;
+
+    const unsigned char *p = data + 12;
+    const unsigned char *end = data + size - hash;
+
+    idx.entries.reserve(count);
+    std::string prev;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (p + fixed > end)
+            return false;
+
+        index_entry e;
+        e.ctime = be32(p);
+        e.ctime_nsec = be32(p + 4);
+        e.mtime = be32(p + 8);
+        e.mtime_nsec = be32(p + 12);
+        e.ino = be32(p + 20);
+        e.mode = be32(p + 24);
+        e.uid = be32(p + 28);
+        e.gid = be32(p + 32);
+        e.size = be32(p + 36);
+        uint16_t flags = be16(p + 40 + hash);
+        e.flags = flags;
+
+        const unsigned char *name = p + fixed;
+        if (flags & INDEX_EXTENDED)
+        {
+            if (version < 3 || name + 2 > end)
+                return false;
+            e.flags |= static_cast<uint32_t>(be16(name)) << 16;
+            name += 2;
+        }
+
+        e.path = idx.paths.size();
+        if (version == 4)
+        {
+            size_t strip;
+            if (!varint(name, end, strip) || strip > prev.size())
+                return false;
+            auto nul = static_cast<const unsigned char *>(memchr(name, 0, end - name));
+            if (!nul)
+                return false;
+            prev.resize(prev.size() - strip);
+            prev.append(reinterpret_cast<const char *>(name), nul - name);
+            idx.paths += prev;
+            p = nul + 1;
+        }
+        else
+        {
+            auto nul = static_cast<const unsigned char *>(memchr(name, 0, end - name));
+            if (!nul)
+                return false;
+            idx.paths.append(reinterpret_cast<const char *>(name), nul - name);
+            // entries are padded with NULs to a multiple of eight bytes
+            p += (name - p + (nul - name) + 8) & ~static_cast<size_t>(7);
+        }
+        e.len = idx.paths.size() - e.path;
+        idx.entries.push_back(e);
+    }
+    return true;
+}
+
+std::shared_ptr<const index> load_index(const std::string &gitdir)
+{
+    auto file = gitdir + "/index";
+
+    std::lock_guard<std::mutex> lock(index_mtx);
+    auto it = indexes.find(gitdir);
+
+    int fd;
+    {
+        cliex::stats::timer t{cliex::stats::CALL_OPEN};
+        fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0)
+    {
+        // a fresh repository has no index yet
+        if (it != indexes.end())
+            indexes.erase(it);
+        return std::make_shared<index>();
+    }
+
+    auto idx = std::make_shared<index>();
+    if (fstat(fd, &idx->st))
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    if (it != indexes.end())
+    {
+        auto &old = it->second->st;
+        if (old.st_ino == idx->st.st_ino && old.st_size == idx->st.st_size
+            && old.st_mtim.tv_sec == idx->st.st_mtim.tv_sec && old.st_mtim.tv_nsec == idx->st.st_mtim.tv_nsec)
+        {
+            ::close(fd);
+            return it->second;
+        }
+    }
+
+    cliex::stats::timer t{cliex::stats::CALL_READ};
+    size_t size = idx->st.st_size;
+    void *data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    madvise(data, size, MADV_SEQUENTIAL);
+    bool ok = parse_index(static_cast<const unsigned char *>(data), size, hash_size(gitdir), *idx);
+    munmap(data, size);
+    if (!ok)
+        return nullptr;
+
+    indexes[gitdir] = idx;
+    return idx;
+}
+
+bool stat_changed(const index_entry &e, const struct stat &st)
+{
+    if ((e.mode & S_IFMT) != (st.st_mode & S_IFMT))
+        return true;
+    if (S_ISREG(st.st_mode) && ((e.mode ^ st.st_mode) & S_IXUSR))
+        return true;
+    if (e.mtime != static_cast<uint32_t>(st.st_mtim.tv_sec) || e.mtime_nsec != static_cast<uint32_t>(st.st_mtim.tv_nsec))
+        return true;
+    if (e.ctime != static_cast<uint32_t>(st.st_ctim.tv_sec) || e.ctime_nsec != static_cast<uint32_t>(st.st_ctim.tv_nsec))
+        return true;
+    if (e.ino != static_cast<uint32_t>(st.st_ino) || e.uid != static_cast<uint32_t>(st.st_uid) || e.gid != static_cast<uint32_t>(st.st_gid))
+        return true;
+    return e.size != static_cast<uint32_t>(st.st_size);
+}
+
+// a file changed no earlier than the index was written may have been
+// changed again after its stat data was taken, git would compare its content
+bool racy(const index_entry &e, const struct stat &index_st)
+{
+    uint32_t sec = static_cast<uint32_t>(index_st.st_mtim.tv_sec);
+    return sec < e.mtime || (sec == e.mtime && static_cast<uint32_t>(index_st.st_mtim.tv_nsec) <= e.mtime_nsec);
+}
+
+std::shared_ptr<const status> compute(const std::string &dir)
+{
+    auto s = std::make_shared<status>();
+
+    char *real = realpath(dir.c_str(), nullptr);
+    if (!real)
+        return s;
+    std::string path = real;
+    free(real);
+
+    // the closest directory above that has a .git
+    std::string top = path, gitdir;
+    while (true)
+    {
+        gitdir = find_gitdir(top);
+        if (!gitdir.empty() || top == "/")
+            break;
+        auto slash = top.rfind('/');
+        top = slash ? top.substr(0, slash) : "/";
+    }
+    if (gitdir.empty())
+        return s;
+
+    if (path != top)
+        s->rel = path.substr(top.size() + (top == "/" ? 0 : 1)) + "/";
+    if (("/" + s->rel).find("/.git/") != std::string::npos)
+        return s;
+
+    auto idx = load_index(gitdir);
+    if (!idx)
+        return s;
+    s->repository = true;
+
+    s->ignores = cliex::ignore::for_dir(path);
+
+    int dirfd;
+    {
+        cliex::stats::timer t{cliex::stats::CALL_DIR_OPEN};
+        dirfd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (dirfd < 0)
+        return s;
+
+    const auto &rel = s->rel;
+    auto less = [&idx](const index_entry &e, const std::string &p)
+    {
+        return idx->path(e) < p;
+    };
+    auto it = std::lower_bound(idx->entries.begin(), idx->entries.end(), rel, less);
+    while (it != idx->entries.end())
+    {
+        auto p = idx->path(*it);
+        if (p.substr(0, rel.size()) != rel)
+            break;
+
+        auto rest = p.substr(rel.size());
+        auto slash = rest.find('/');
+        if (slash != std::string_view::npos)
+        {
+            // a directory with tracked files, '0' sorts right after '/'
+            std::string name{rest.substr(0, slash)};
+            it = std::lower_bound(it, idx->entries.end(), rel + name + "0", less);
+            s->tracked.insert(std::move(name));
+            continue;
+        }
+
+        std::string name{rest};
+        const auto &e = *it++;
+        if (e.flags & INDEX_STAGE)
+        {
+            s->unmerged.insert(name);
+        }
+        else if (!(e.flags & (INDEX_ASSUME_VALID | INDEX_SKIP_WORKTREE)) && (e.mode & S_IFMT) != S_IFDIR && (e.mode & S_IFMT) != 0160000)
+        {
+            struct stat st;
+            int res;
+            {
+                cliex::stats::timer t{cliex::stats::CALL_SYMLINK_STATUS};
+                res = fstatat(dirfd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW);
+            }
+            if (res == 0 && stat_changed(e, st))
+                s->modified.insert(name);
+            else if (res == 0 && racy(e, idx->st))
+                s->racy.insert(name);
+        }
+        s->tracked.insert(std::move(name));
+    }
+    ::close(dirfd);
+    return s;
+}
+
+void evict()
+{
+    while (dirs.size() > GIT_MAX_DIRS)
+    {
+        auto oldest = dirs.end();
+        for (auto it = dirs.begin(); it != dirs.end(); ++it)
+        {
+            if (!it->second.running && (oldest == dirs.end() || it->second.used < oldest->second.used))
+                oldest = it;
+        }
+        if (oldest == dirs.end())
+            return;
+        dirs.erase(oldest);
+    }
+}
+
+cliex::aio::task<void> update(std::string dir)
+{
+    std::shared_ptr<const status> s;
+    try
+    {
+        s = co_await cliex::aio::offload([&dir]
+        {
+            return compute(dir);
+        }, cliex::PRIORITY_PREFETCH);
+    }
+    catch (const std::exception&)
+    {
+        s = std::make_shared<status>();
+    }
+
+    auto &d = dirs[dir];
+    d.marks = std::move(s);
+    d.running = false;
+    arrived = true;
+
+    // changes that came in meanwhile
+    if (d.again)
+    {
+        d.again = false;
+        d.running = true;
+        cliex::aio::spawn(update(dir));
+    }
+}
+}
+
+void cliex::git::refresh(const listing &l)
+{
+    if (!get_vfs().native())
+        return;
+
+    auto dir = l.dir.string();
+    auto &d = dirs[dir];
+    d.used = ++last_use;
+    if (d.running)
+    {
+        d.again = true;
+        return;
+    }
+
+    d.running = true;
+    cliex::aio::spawn(update(dir));
+    evict();
+}
+
+char cliex::git::mark(const listing &l, size_t i)
+{
+    auto it = dirs.find(l.dir.string());
+    if (it == dirs.end())
+    {
+        refresh(l);
+        return 0;
+    }
+
+    it->second.used = ++last_use;
+    const auto &s = it->second.marks;
+    if (!s || !s->repository || i >= l.entries.size())
+        return 0;
+
+    std::string name = l.entries[i];
+    if (name == "..")
+        return ' ';
+    bool dir = !name.empty() && name.back() == '/';
+    if (dir)
+        name.pop_back();
+
+    if (s->unmerged.count(name))
+        return GIT_MARK_UNMERGED;
+    if (s->modified.count(name))
+        return GIT_MARK_MODIFIED;
+    if (s->racy.count(name))
+        return GIT_MARK_UNKNOWN;
+    if (s->tracked.count(name) || (dir && name == ".git"))
+        return ' ';
+    if (s->ignores && s->ignores->git_ignored(name, dir))
+        return GIT_MARK_IGNORED;
+    return GIT_MARK_UNTRACKED;
+}
+
+bool cliex::git::repository(const fs::path &dir)
+{
+    auto it = dirs.find(dir.string());
+    return it != dirs.end() && it->second.marks && it->second.marks->repository;
+}
+
+bool cliex::git::changed()
+{
+    return std::exchange(arrived, false);
+}
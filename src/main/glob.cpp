@@ -0,0 +1,209 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * glob.cpp
+ *
+ * Matching backtracks over the stars. A star that is followed by a literal
+ * only tries the places where that literal starts.
+*/
+
+#include <string>
+#include <string_view>
+
+#include <algorithm>
+
+#include "glob.hpp"
+
+bool cliex::glob::has_meta(std::string_view p)
+{
+    return p.find_first_of("*?[\\") != std::string_view::npos;
+}
+
+cliex::glob::glob(std::string_view p)
+{
+    auto &g = tokens;
+    auto literal = [&g](char c)
+    {
+        if (g.empty() || g.back().kind != OP_LITERAL)
+            g.push_back({OP_LITERAL});
+        g.back().text += c;
+    };
+
+    size_t n = p.size();
+    for (size_t i = 0; i < n;)
+    {
+        char c = p[i];
+        if (c == '*')
+        {
+            bool whole = (i == 0 || p[i - 1] == '/') && i + 1 < n && p[i + 1] == '*';
+            if (whole && i + 2 == n)
+            {
+                g.push_back({OP_GLOBSTAR});
+                break;
+            }
+            if (whole && p[i + 2] == '/')
+            {
+                g.push_back({OP_DIRS});
+                i += 3;
+                continue;
+            }
+
+            while (i < n && p[i] == '*')
+                i++;
+            g.push_back({OP_STAR});
+            continue;
+        }
+
+        if (c == '?')
+        {
+            g.push_back({OP_ANY});
+            i++;
+            continue;
+        }
+
+        if (c == '[')
+        {
+            token t{OP_CLASS};
+            size_t j = i + 1;
+            if (j < n && (p[j] == '!' || p[j] == '^'))
+            {
+                t.negate = true;
+                j++;
+            }
+
+            // a ']' right at the start is part of the class
+            bool closed = false;
+            for (bool first = true; j < n; first = false)
+            {
+                if (p[j] == ']' && !first)
+                {
+                    closed = true;
+                    break;
+                }
+                unsigned char lo = p[j] == '\\' && j + 1 < n ? p[++j] : p[j];
+                j++;
+                unsigned char hi = lo;
+                if (j + 1 < n && p[j] == '-' && p[j + 1] != ']')
+                {
+                    hi = p[j + 1] == '\\' && j + 2 < n ? p[j + 2] : p[j + 1];
+                    j += p[j + 1] == '\\' ? 3 : 2;
+                }
+                for (unsigned c = lo; c <= hi; c++)
+                    t.set.set(c);
+            }
+
+            if (closed)
+            {
+                g.push_back(std::move(t));
+                i = j + 1;
+            }
+            else
+            {
+                literal('[');
+                i++;
+            }
+            continue;
+        }
+
+        if (c == '\\' && i + 1 < n)
+            i++;
+        literal(p[i++]);
+    }
+}
+
+bool cliex::glob::match(const token *t, const token *end, std::string_view s)
+{
+    for (; t != end; ++t)
+    {
+        switch (t->kind)
+        {
+        case OP_LITERAL:
+            if (s.substr(0, t->text.size()) != t->text)
+                return false;
+            s.remove_prefix(t->text.size());
+            break;
+
+        case OP_ANY:
+        case OP_CLASS:
+            if (s.empty() || s[0] == '/')
+                return false;
+            if (t->kind == OP_CLASS && t->set[static_cast<unsigned char>(s[0])] == t->negate)
+                return false;
+            s.remove_prefix(1);
+            break;
+
+        case OP_STAR:
+        {
+            size_t segment = std::min(s.find('/'), s.size());
+            if (t + 1 == end)
+                return segment == s.size();
+
+            // only where the literal that follows starts, or right at the
+            // end if nothing follows it
+            if ((t + 1)->kind == OP_LITERAL)
+            {
+                const auto &next = (t + 1)->text;
+                if (t + 2 == end)
+                    return s.size() >= next.size() && segment >= s.size() - next.size() && s.substr(s.size() - next.size()) == next;
+
+                for (size_t i = s.find(next); i != std::string_view::npos && i <= segment; i = s.find(next, i + 1))
+                {
+                    if (match(t + 1, end, s.substr(i)))
+                        return true;
+                }
+                return false;
+            }
+
+            for (size_t i = 0; i <= segment; i++)
+            {
+                if (match(t + 1, end, s.substr(i)))
+                    return true;
+            }
+            return false;
+        }
+
+        case OP_GLOBSTAR:
+            if (t + 1 == end)
+                return true;
+            for (size_t i = 0; i <= s.size(); i++)
+            {
+                if (match(t + 1, end, s.substr(i)))
+                    return true;
+            }
+            return false;
+
+        case OP_DIRS:
+            for (size_t i = 0;;)
+            {
+                if (match(t + 1, end, s.substr(i)))
+                    return true;
+                size_t slash = s.find('/', i);
+                if (slash == std::string_view::npos)
+                    return false;
+                i = slash + 1;
+            }
+        }
+    }
+    return s.empty();
+}
+
+bool cliex::glob::match(std::string_view s) const
+{
+    return match(tokens.data(), tokens.data() + tokens.size(), s);
+}
@@ -0,0 +1,330 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * grid.cpp
+ *
+ * Only the visible rows are drawn, so a frame costs the same for ten
+ * entries and for a million.
+*/
+
+#include <string>
+#include <vector>
+
+#include <algorithm>
+
+#include <ncurses.h>
+
+#include "grid.hpp"
+#include "width.hpp"
+#include "frame.hpp"
+
+void cliex::grid_layout::assign(const std::vector<unsigned short> *w)
+{
+    widths = w;
+    block_max.clear();
+    changed(0);
+}
+
+void cliex::grid_layout::changed(size_t index)
+{
+    const auto &w = *widths;
+    size_t first = index / GRID_BLOCK;
+    block_max.resize((w.size() + GRID_BLOCK - 1) / GRID_BLOCK);
+    for (size_t b = first; b < block_max.size(); b++)
+    {
+        auto begin = w.begin() + b * GRID_BLOCK;
+        auto end = w.begin() + std::min(w.size(), (b + 1) * GRID_BLOCK);
+        block_max[b] = *std::max_element(begin, end);
+    }
+}
+
+unsigned cliex::grid_layout::range_max(size_t first, size_t last) const
+{
+    const auto &w = *widths;
+    unsigned m = 0;
+    while (first < last && first % GRID_BLOCK)
+        m = std::max<unsigned>(m, w[first++]);
+    while (first + GRID_BLOCK <= last)
+    {
+        m = std::max<unsigned>(m, block_max[first / GRID_BLOCK]);
+        first += GRID_BLOCK;
+    }
+    while (first < last)
+        m = std::max<unsigned>(m, w[first++]);
+    return m;
+}
+
+// stops at the first column that doesn't fit anymore
+bool cliex::grid_layout::try_rows(size_t rows, unsigned width, unsigned cap, unsigned extra, std::vector<unsigned> &cols) const
+{
+    size_t n = widths->size();
+    cols.clear();
+
+    unsigned total = 0;
+    for (size_t first = 0; first < n; first += rows)
+    {
+        unsigned w = std::min(range_max(first, std::min(n, first + rows)), cap);
+        total += w + extra + (cols.empty() ? 0 : GRID_GAP);
+        if (total > width)
+            return false;
+        cols.push_back(w);
+    }
+    return true;
+}
+
+void cliex::grid_layout::search(unsigned width, unsigned max_columns, unsigned cap, unsigned extra)
+{
+    size_t n = widths->size();
+    size_t most = std::min<size_t>({n, max_columns, (width + GRID_GAP) / (1 + extra + GRID_GAP)});
+    std::vector<unsigned> cols;
+
+    // different column counts can lead to the same number of rows, every
+    // row count is tried once
+    size_t last_rows = 0;
+    for (size_t c = most; c > 1; c--)
+    {
+        size_t rows = (n + c - 1) / c;
+        if (rows == last_rows)
+            continue;
+        last_rows = rows;
+
+        if (try_rows(rows, width, cap, extra, cols))
+        {
+            row_count = rows;
+            column_widths.swap(cols);
+            return;
+        }
+    }
+
+    row_count = n;
+    column_widths.assign(1, std::min(range_max(0, n), cap));
+}
+
+void cliex::grid_layout::fit(unsigned width, unsigned height, unsigned max_columns, unsigned extra)
+{
+    row_count = 0;
+    column_widths.clear();
+    if (!widths || widths->empty() || width <= extra)
+        return;
+
+    search(width, std::max(max_columns, 1u), width - extra, extra);
+    unsigned narrow = (width + GRID_GAP) / GRID_MIN_COLUMNS;
+    if (row_count > height && columns() < GRID_MIN_COLUMNS && max_columns >= GRID_MIN_COLUMNS)
+        search(width, max_columns, narrow > GRID_GAP + extra + 1 ? narrow - GRID_GAP - extra : 1, extra);
+}
+
+size_t cliex::grid_layout::memory() const
+{
+    return block_max.capacity() * sizeof(block_max[0]) + column_widths.capacity() * sizeof(column_widths[0]);
+}
+
+cliex::file_grid::~file_grid()
+{
+    close();
+}
+
+void cliex::file_grid::place(WINDOW *parent, int height, int width, int starty, int startx)
+{
+    close();
+    win = derwin(parent, height, width, starty, startx);
+}
+
+void cliex::file_grid::close()
+{
+    if (win)
+    {
+        frame::forget(win);
+        delwin(win);
+    }
+    win = nullptr;
+}
+
+void cliex::file_grid::assign(const std::vector<std::string> *n, const std::vector<unsigned short> *w, unsigned max_cols)
+{
+    names = n;
+    widths = w;
+    max_columns = max_cols;
+    current = top = 0;
+
+    layout.assign(widths);
+    fit();
+}
+
+void cliex::file_grid::changed(size_t index)
+{
+    layout.changed(index);
+    fit();
+    move_to(std::min(current, names->empty() ? 0 : names->size() - 1));
+}
+
+void cliex::file_grid::reflow()
+{
+    fit();
+    top = 0;
+    move_to(current);
+}
+
+void cliex::file_grid::limit(unsigned columns)
+{
+    column_limit = columns;
+}
+
+void cliex::file_grid::marks(std::function<char(size_t)> f)
+{
+    bool had = static_cast<bool>(mark_of);
+    mark_of = std::move(f);
+    if (had != static_cast<bool>(mark_of) && win && names)
+    {
+        fit();
+        move_to(current);
+    }
+}
+
+void cliex::file_grid::fit()
+{
+    layout.fit(getmaxx(win), getmaxy(win), std::min(max_columns, column_limit), mark_of ? GRID_MARK_WIDTH : 0);
+}
+
+void cliex::file_grid::move_to(size_t index)
+{
+    if (names->empty())
+        return;
+
+    // without rows the window is too narrow to show anything
+    current = std::min(index, names->size() - 1);
+    if (!layout.rows())
+        return;
+    size_t row = current % layout.rows();
+    size_t height = getmaxy(win);
+    if (row < top)
+        top = row;
+    else if (row >= top + height)
+        top = row - height + 1;
+}
+
+void cliex::file_grid::down()
+{
+    move_to(current + 1);
+}
+
+void cliex::file_grid::up()
+{
+    if (current > 0)
+        move_to(current - 1);
+}
+
+void cliex::file_grid::right()
+{
+    if (layout.rows() && current + layout.rows() < names->size())
+        move_to(current + layout.rows());
+}
+
+void cliex::file_grid::left()
+{
+    if (layout.rows() && current >= layout.rows())
+        move_to(current - layout.rows());
+}
+
+// pages move within the column, like the rows on screen
+void cliex::file_grid::page_down()
+{
+    if (names->empty() || !layout.rows())
+        return;
+
+    size_t rows = layout.rows();
+    size_t column = current / rows * rows;
+    size_t row = std::min(current % rows + getmaxy(win), rows - 1);
+    move_to(std::min(column + row, names->size() - 1));
+}
+
+void cliex::file_grid::page_up()
+{
+    if (names->empty() || !layout.rows())
+        return;
+
+    size_t rows = layout.rows();
+    size_t column = current / rows * rows;
+    size_t row = current % rows;
+    move_to(column + (row > static_cast<size_t>(getmaxy(win)) ? row - getmaxy(win) : 0));
+}
+
+void cliex::file_grid::select(size_t index)
+{
+    move_to(index);
+}
+
+std::string cliex::file_grid::selected() const
+{
+    return names->empty() ? "" : (*names)[current];
+}
+
+void cliex::file_grid::draw()
+{
+    werase(win);
+
+    size_t rows = layout.rows();
+    size_t height = getmaxy(win);
+    for (size_t r = top; r < std::min(rows, top + height); r++)
+    {
+        int x = 0;
+        for (size_t c = 0; c < layout.columns(); c++)
+        {
+            size_t i = c * rows + r;
+            if (i >= names->size())
+                break;
+
+            const auto &name = (*names)[i];
+            unsigned cw = layout.column_width(c);
+            if (mark_of)
+            {
+                char m = mark_of(i);
+                mvwaddch(win, r - top, x, m ? m : ' ');
+                x += GRID_MARK_WIDTH;
+            }
+            if (i == current)
+                wattron(win, A_REVERSE);
+
+            if ((*widths)[i] <= cw)
+            {
+                mvwaddstr(win, r - top, x, name.c_str());
+                if (i == current)
+                    whline(win, ' ', cw - (*widths)[i]);
+            }
+            else
+            {
+                // the truncated name may end before the column does
+                size_t bytes = display_prefix(name, cw - 1);
+                mvwaddnstr(win, r - top, x, name.c_str(), bytes);
+                waddch(win, GRID_TRUNCATED);
+                if (i == current)
+                    whline(win, ' ', x + static_cast<int>(cw) - getcurx(win));
+            }
+
+            if (i == current)
+                wattroff(win, A_REVERSE);
+            x += cw + GRID_GAP;
+        }
+    }
+    frame::touch(win);
+}
+
+size_t cliex::file_grid::memory() const
+{
+    return layout.memory();
+}
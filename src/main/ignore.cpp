@@ -0,0 +1,406 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * ignore.cpp
+ *
+ * Most patterns are plain names (node_modules, build/), extensions (*.o)
+ * or plain paths; those are looked up in hash tables at the cost of a
+ * single lookup however many patterns there are. The rest are compiled to
+ * token sequences. Within a file the last matching pattern wins, so every
+ * table keeps the highest pattern number per key and the compiled patterns
+ * are tried from the last one down, only while they could still win.
+*/
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+#include <algorithm>
+
+#include <memory>
+#include <mutex>
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ignore.hpp"
+#include "glob.hpp"
+#include "stats.hpp"
+
+namespace
+{
+struct best
+{
+    int any = -1;
+    int dir = -1;
+};
+
+struct rule
+{
+    bool negate;
+    bool dir_only;
+};
+
+struct view_hash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const
+    {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+using table = std::unordered_map<std::string, best, view_hash, std::equal_to<>>;
+
+bool read_at(int dirfd, const char *file, std::string &out)
+{
+    int fd;
+    {
+        cliex::stats::timer t{cliex::stats::CALL_OPEN};
+        fd = openat(dirfd, file, O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0)
+        return false;
+
+    cliex::stats::timer t{cliex::stats::CALL_READ};
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+        out.append(buf, n);
+    ::close(fd);
+    return n == 0;
+}
+
+std::mutex mtx;
+std::unordered_map<std::string, std::shared_ptr<const cliex::ignore::matcher>> matchers;
+}
+
+struct cliex::ignore::layer
+{
+    // from a .gitignore, info/exclude or the user's excludes
+    bool git = false;
+    std::vector<rule> rules;
+    table names;
+    // names ending in an extension, the key starts at its '.'
+    table suffixes;
+    table paths;
+    std::vector<std::pair<cliex::glob, int>> name_globs;
+    std::vector<std::pair<cliex::glob, int>> path_globs;
+
+    // the number of the pattern that decides, -1 if none matches
+    int find(const std::string &prefix, std::string_view name, bool dir) const
+    {
+        int r = -1;
+        auto take = [&r, dir](const best &b)
+        {
+            r = std::max(r, dir ? std::max(b.any, b.dir) : b.any);
+        };
+
+        if (auto it = names.find(name); it != names.end())
+            take(it->second);
+        if (!suffixes.empty())
+        {
+            for (size_t dot = name.find('.'); dot != std::string_view::npos; dot = name.find('.', dot + 1))
+            {
+                if (auto it = suffixes.find(name.substr(dot)); it != suffixes.end())
+                    take(it->second);
+            }
+        }
+
+        for (auto g = name_globs.rbegin(); g != name_globs.rend() && g->second > r; ++g)
+        {
+            if ((dir || !rules[g->second].dir_only) && g->first.match(name))
+            {
+                r = g->second;
+                break;
+            }
+        }
+
+        if (paths.empty() && path_globs.empty())
+            return r;
+
+        thread_local std::string path;
+        path = prefix;
+        path += name;
+        if (auto it = paths.find(path); it != paths.end())
+            take(it->second);
+        for (auto g = path_globs.rbegin(); g != path_globs.rend() && g->second > r; ++g)
+        {
+            if ((dir || !rules[g->second].dir_only) && g->first.match(path))
+            {
+                r = g->second;
+                break;
+            }
+        }
+        return r;
+    }
+
+    void add(std::string line)
+    {
+        while (!line.empty() && (line.back() == '\r' || (line.back() == ' ' && (line.size() < 2 || line[line.size() - 2] != '\\'))))
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            return;
+
+        rule r{false, false};
+        if (line[0] == '!')
+        {
+            r.negate = true;
+            line.erase(0, 1);
+        }
+        else if (line[0] == '\\' && line.size() > 1 && (line[1] == '#' || line[1] == '!'))
+        {
+            line.erase(0, 1);
+        }
+        if (!line.empty() && line.back() == '/')
+        {
+            r.dir_only = true;
+            line.pop_back();
+        }
+
+        // **/name matches at any depth, like a plain name
+        if (line.compare(0, 3, "**/") == 0 && line.find('/', 3) == std::string::npos)
+            line.erase(0, 3);
+        bool anchored = line.find('/') != std::string::npos;
+        if (!line.empty() && line[0] == '/')
+            line.erase(0, 1);
+        if (line.empty())
+            return;
+
+        int index = rules.size();
+        rules.push_back(r);
+        auto put = [&r, index](best &b)
+        {
+            (r.dir_only ? b.dir : b.any) = index;
+        };
+
+        if (anchored)
+        {
+            if (cliex::glob::has_meta(line))
+                path_globs.emplace_back(cliex::glob(line), index);
+            else
+                put(paths[line]);
+        }
+        else if (!cliex::glob::has_meta(line))
+        {
+            put(names[line]);
+        }
+        else if (line.size() > 2 && line[0] == '*' && line[1] == '.' && !cliex::glob::has_meta(line.substr(1)))
+        {
+            put(suffixes[line.substr(1)]);
+        }
+        else
+        {
+            name_globs.emplace_back(cliex::glob(line), index);
+        }
+    }
+};
+
+namespace
+{
+using cliex::ignore::layer;
+
+std::shared_ptr<const layer> parse(const std::string &content, bool git)
+{
+    auto l = std::make_shared<layer>();
+    l->git = git;
+
+    size_t pos = 0;
+    while (pos < content.size())
+    {
+        size_t eol = content.find('\n', pos);
+        if (eol == std::string::npos)
+            eol = content.size();
+        l->add(content.substr(pos, eol - pos));
+        pos = eol + 1;
+    }
+    return l->rules.empty() ? nullptr : l;
+}
+
+std::shared_ptr<const layer> load(int dirfd, const char *file, bool git)
+{
+    std::string content;
+    if (!read_at(dirfd, file, content))
+        return nullptr;
+    return parse(content, git);
+}
+
+// core.excludesFile at its default place
+std::shared_ptr<const layer> user_excludes()
+{
+    static std::once_flag once;
+    static std::shared_ptr<const layer> excludes;
+    std::call_once(once, []
+    {
+        std::string file;
+        if (auto xdg = getenv("XDG_CONFIG_HOME"); xdg && *xdg)
+            file = std::string(xdg) + "/git/ignore";
+        else if (auto home = getenv("HOME"))
+            file = std::string(home) + "/.config/git/ignore";
+        if (!file.empty())
+            excludes = load(AT_FDCWD, file.c_str(), true);
+    });
+    return excludes;
+}
+}
+
+bool cliex::ignore::matcher::match(std::string_view name, bool dir, bool git_only) const
+{
+    if (git_only ? all_git : all)
+        return true;
+
+    // the innermost file that has a say decides
+    for (auto it = layers.rbegin(); it != layers.rend(); ++it)
+    {
+        if (git_only && !it->rules->git)
+            continue;
+        int r = it->rules->find(it->prefix, name, dir);
+        if (r >= 0)
+            return !it->rules->rules[r].negate;
+    }
+    return false;
+}
+
+bool cliex::ignore::matcher::ignored(std::string_view name, bool dir) const
+{
+    return match(name, dir, false);
+}
+
+bool cliex::ignore::matcher::git_ignored(std::string_view name, bool dir) const
+{
+    return match(name, dir, true);
+}
+
+std::shared_ptr<const cliex::ignore::matcher> cliex::ignore::matcher::child(std::string_view name, int dirfd) const
+{
+    auto m = std::make_shared<matcher>();
+    m->all = all || (!name.empty() && ignored(name, true));
+    m->all_git = all_git || (!name.empty() && git_ignored(name, true));
+
+    struct stat st;
+    bool top;
+    {
+        stats::timer t{stats::CALL_SYMLINK_STATUS};
+        top = fstatat(dirfd, ".git", &st, AT_SYMLINK_NOFOLLOW) == 0;
+    }
+
+    // a nested repository starts over with git's rules
+    bool work_tree = top;
+    m->layers.reserve(layers.size() + 4);
+    for (const auto &l : layers)
+    {
+        if (l.rules->git)
+            work_tree = true;
+        if (top && l.rules->git)
+            continue;
+        m->layers.push_back({l.rules, l.prefix + std::string(name) + "/"});
+    }
+    if (top)
+    {
+        m->all_git = false;
+        if (auto excludes = user_excludes())
+            m->layers.push_back({excludes, ""});
+        if (S_ISDIR(st.st_mode))
+        {
+            if (auto exclude = load(dirfd, ".git/info/exclude", true))
+                m->layers.push_back({exclude, ""});
+        }
+    }
+
+    if (work_tree)
+    {
+        if (auto gitignore = load(dirfd, ".gitignore", true))
+            m->layers.push_back({gitignore, ""});
+    }
+    if (auto own = load(dirfd, ".ignore", false))
+        m->layers.push_back({own, ""});
+    return m;
+}
+
+std::shared_ptr<const cliex::ignore::matcher> cliex::ignore::for_dir(const std::string &dir)
+{
+    char *real = realpath(dir.c_str(), nullptr);
+    if (!real)
+        return nullptr;
+    std::string path = real;
+    free(real);
+
+    // the closest ancestor that is known already
+    std::shared_ptr<const matcher> m;
+    std::vector<std::string> below;
+    std::string at = path;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        while (true)
+        {
+            auto it = matchers.find(at);
+            if (it != matchers.end())
+            {
+                m = it->second;
+                break;
+            }
+            if (at == "/")
+                break;
+
+            size_t slash = at.rfind('/');
+            below.push_back(at.substr(slash + 1));
+            at.resize(slash ? slash : 1);
+        }
+    }
+    if (m && below.empty())
+        return m;
+
+    auto step = [](const std::shared_ptr<const matcher> &parent, const std::string &dir, const std::string &name)
+    {
+        int fd;
+        {
+            stats::timer t{stats::CALL_DIR_OPEN};
+            fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+        if (fd < 0)
+            return std::shared_ptr<const matcher>();
+        auto child = parent->child(name, fd);
+        ::close(fd);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (matchers.size() >= IGNORE_MAX_DIRS)
+            matchers.clear();
+        matchers[dir] = child;
+        return child;
+    };
+
+    if (!m)
+        m = step(std::make_shared<matcher>(), "/", "");
+    for (auto it = below.rbegin(); it != below.rend() && m; ++it)
+    {
+        at += at == "/" ? *it : "/" + *it;
+        m = step(m, at, *it);
+    }
+    return m;
+}
+
+void cliex::ignore::forget()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    matchers.clear();
+}
@@ -0,0 +1,188 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * info.cpp
+ *
+ * One read per entry runs at a time. A read only counts as news when the
+ * metadata differs from what is shown, so the pane isn't redrawn every
+ * INFO_TTL_MS while the cursor rests.
+*/
+
+#include <string>
+#include <unordered_map>
+
+#include <chrono>
+#include <utility>
+
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "info.hpp"
+#include "vfs.hpp"
+#include "aio.hpp"
+#include "pool.hpp"
+#include "stats.hpp"
+
+namespace
+{
+struct record
+{
+    cliex::info::details details;
+    bool known = false;
+    bool running = false;
+    long long expires = 0;
+    unsigned long used = 0;
+};
+
+std::unordered_map<std::string, record> records;
+unsigned long last_use = 0;
+bool arrived = false;
+
+long long now()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+fs::file_status to_status(mode_t mode)
+{
+    fs::file_type type;
+    switch (mode & S_IFMT)
+    {
+    case S_IFREG: type = fs::file_type::regular; break;
+    case S_IFDIR: type = fs::file_type::directory; break;
+    case S_IFLNK: type = fs::file_type::symlink; break;
+    case S_IFBLK: type = fs::file_type::block; break;
+    case S_IFCHR: type = fs::file_type::character; break;
+    case S_IFIFO: type = fs::file_type::fifo; break;
+    case S_IFSOCK: type = fs::file_type::socket; break;
+    default: type = fs::file_type::unknown; break;
+    }
+    return fs::file_status(type, static_cast<fs::perms>(mode & 07777));
+}
+
+// a link is stat'ed a second time for what it points to
+cliex::info::details read_native(const std::string &path)
+{
+    cliex::info::details d;
+    struct stat st;
+    int res;
+    {
+        cliex::stats::timer t{cliex::stats::CALL_SYMLINK_STATUS};
+        res = lstat(path.c_str(), &st);
+    }
+    if (res)
+    {
+        d.error = fs::filesystem_error("cannot stat", path, std::error_code(errno, std::generic_category())).what();
+        return d;
+    }
+
+    d.link = to_status(st.st_mode);
+    if (S_ISLNK(st.st_mode))
+    {
+        struct stat target;
+        cliex::stats::timer t{cliex::stats::CALL_STATUS};
+        if (stat(path.c_str(), &target) == 0)
+            st = target;
+    }
+    d.status = to_status(st.st_mode);
+    d.size = st.st_size;
+    d.owner = {st.st_uid, st.st_gid};
+    d.mtime = st.st_mtim.tv_sec;
+    return d;
+}
+
+cliex::info::details read_vfs(const fs::path &path)
+{
+    cliex::info::details d;
+    auto &vfs = cliex::get_vfs();
+    try
+    {
+        d.link = vfs.symlink_status(path);
+        d.status = fs::is_symlink(d.link) ? vfs.status(path) : d.link;
+        if (!fs::is_directory(d.status))
+            d.size = vfs.file_size(path);
+        d.owner = vfs.owner(path);
+        d.mtime = fs::file_time_type::clock::to_time_t(vfs.last_write_time(path));
+    }
+    catch (const fs::filesystem_error &e)
+    {
+        d.error = e.what();
+    }
+    return d;
+}
+
+bool same(const cliex::info::details &a, const cliex::info::details &b)
+{
+    return a.status.type() == b.status.type() && a.status.permissions() == b.status.permissions() && a.link.type() == b.link.type()
+        && a.size == b.size && a.owner.uid == b.owner.uid && a.owner.gid == b.owner.gid && a.mtime == b.mtime && a.error == b.error;
+}
+
+// only records no read is running for can go
+void evict()
+{
+    while (records.size() > INFO_CACHED)
+    {
+        auto oldest = records.end();
+        for (auto it = records.begin(); it != records.end(); ++it)
+        {
+            if (!it->second.running && (oldest == records.end() || it->second.used < oldest->second.used))
+                oldest = it;
+        }
+        if (oldest == records.end())
+            return;
+        records.erase(oldest);
+    }
+}
+
+cliex::aio::task<void> load(std::string path)
+{
+    auto d = co_await cliex::aio::offload([&path]
+    {
+        cliex::pool::io_slot io;
+        return cliex::get_vfs().native() ? read_native(path) : read_vfs(path);
+    }, cliex::PRIORITY_VISIBLE);
+
+    auto &r = records[path];
+    if (!r.known || !same(r.details, d))
+        arrived = true;
+    r.details = std::move(d);
+    r.known = true;
+    r.running = false;
+    r.expires = now() + INFO_TTL_MS;
+    evict();
+}
+}
+
+const cliex::info::details *cliex::info::get(const fs::path &path)
+{
+    evict();
+    auto &r = records[path.string()];
+    r.used = ++last_use;
+    if (!r.running && (!r.known || now() >= r.expires))
+    {
+        r.running = true;
+        aio::spawn(load(path.string()));
+    }
+    return r.known ? &r.details : nullptr;
+}
+
+bool cliex::info::changed()
+{
+    return std::exchange(arrived, false);
+}
@@ -0,0 +1,583 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * list.cpp
+ *
+ * Entries are written as they are enumerated, unless they are sorted; with
+ * --recursive, the subdirectories of a directory follow once it's done, like
+ * ls -R. Links are listed, never followed.
+*/
+
+#include <iostream>
+
+#include <string>
+#include <string_view>
+
+#include <vector>
+#include <map>
+#include <memory>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+
+#include <experimental/filesystem>
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "list.hpp"
+#include "cliex.hpp"
+#include "stats.hpp"
+#include "vfs.hpp"
+#include "ignore.hpp"
+#include "filter.hpp"
+
+namespace fs = std::experimental::filesystem;
+using std::literals::string_literals::operator""s;
+
+namespace
+{
+enum format
+{
+    FORMAT_TSV,
+    FORMAT_JSON,
+    FORMAT_NUL
+};
+
+class writer
+{
+public:
+    explicit writer(int fd) : fd(fd), buf(new char[LIST_BUFFER_SIZE])
+    {
+    }
+
+    ~writer()
+    {
+        flush();
+    }
+
+    void put(char c)
+    {
+        if (used == LIST_BUFFER_SIZE)
+            flush();
+        buf[used++] = c;
+    }
+
+    void put(std::string_view s)
+    {
+        if (s.size() > LIST_BUFFER_SIZE - used)
+            flush();
+        if (s.size() >= LIST_BUFFER_SIZE)
+        {
+            write_all(s.data(), s.size());
+            return;
+        }
+        memcpy(buf.get() + used, s.data(), s.size());
+        used += s.size();
+    }
+
+    void put(long long n)
+    {
+        char digits[24];
+        auto end = std::to_chars(digits, digits + sizeof digits, n).ptr;
+        put(std::string_view(digits, end - digits));
+    }
+
+    void flush()
+    {
+        write_all(buf.get(), used);
+        used = 0;
+    }
+
+    bool failed = false;
+    int error = 0;
+
+private:
+    void write_all(const char *p, size_t n)
+    {
+        while (n && !failed)
+        {
+            auto written = write(fd, p, n);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+            {
+                error = written < 0 ? errno : EIO;
+                failed = true;
+                break;
+            }
+            p += written;
+            n -= written;
+        }
+    }
+
+    int fd;
+    std::unique_ptr<char[]> buf;
+    size_t used = 0;
+};
+
+// tabs and newlines in names would break the columns
+void put_tsv(writer &out, std::string_view s)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        const char *escape = s[i] == '\t' ? "\\t" : s[i] == '\n' ? "\\n" : s[i] == '\r' ? "\\r" : s[i] == '\\' ? "\\\\" : nullptr;
+        if (!escape)
+            continue;
+        out.put(s.substr(start, i - start));
+        out.put(std::string_view(escape));
+        start = i + 1;
+    }
+    out.put(s.substr(start));
+}
+
+// names are written byte for byte, only quotes, backslashes and control
+// characters are escaped
+void put_json(writer &out, std::string_view s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out.put('"');
+    size_t start = 0;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        auto c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        out.put(s.substr(start, i - start));
+        out.put('\\');
+        if (c == '"' || c == '\\')
+            out.put(static_cast<char>(c));
+        else if (c == '\n')
+            out.put('n');
+        else if (c == '\t')
+            out.put('t');
+        else
+        {
+            out.put(std::string_view("u00"));
+            out.put(hex[c >> 4]);
+            out.put(hex[c & 0xf]);
+        }
+        start = i + 1;
+    }
+    out.put(s.substr(start));
+    out.put('"');
+}
+
+const char *kind(fs::file_type t)
+{
+    switch (t)
+    {
+    case fs::file_type::regular:
+        return "file";
+    case fs::file_type::directory:
+        return "dir";
+    case fs::file_type::symlink:
+        return "symlink";
+    case fs::file_type::block:
+        return "block";
+    case fs::file_type::character:
+        return "char";
+    case fs::file_type::fifo:
+        return "fifo";
+    case fs::file_type::socket:
+        return "socket";
+    default:
+        return "other";
+    }
+}
+
+struct meta
+{
+    fs::file_status link;
+    fs::file_status status;
+    long long size = 0;
+    long long mtime = 0;
+};
+
+fs::file_status to_status(const struct stat &st)
+{
+    auto t = S_ISREG(st.st_mode) ? fs::file_type::regular
+           : S_ISDIR(st.st_mode) ? fs::file_type::directory
+           : S_ISLNK(st.st_mode) ? fs::file_type::symlink
+           : S_ISBLK(st.st_mode) ? fs::file_type::block
+           : S_ISCHR(st.st_mode) ? fs::file_type::character
+           : S_ISFIFO(st.st_mode) ? fs::file_type::fifo
+           : S_ISSOCK(st.st_mode) ? fs::file_type::socket
+           : fs::file_type::unknown;
+    return fs::file_status(t, static_cast<fs::perms>(st.st_mode & 07777));
+}
+
+fs::filesystem_error os_error(const char *what, const fs::path &path, int err)
+{
+    return fs::filesystem_error(what, path, std::error_code(err, std::generic_category()));
+}
+
+class lister
+{
+public:
+    lister(format f, bool recursive, bool sorted, const cliex::entry_filter &filter, bool hide_ignored, std::map<std::string, std::string> &ftypes)
+        : out(STDOUT_FILENO), f(f), recursive(recursive), sorted(sorted), filter(filter), hide_ignored(hide_ignored), ftypes(ftypes), dents(DIRENT_BUFFER_SIZE)
+    {
+    }
+
+    // prints the entry and returns whether it's a directory to descend into
+    bool entry(const fs::path &path)
+    {
+        auto &vfs = cliex::get_vfs();
+        try
+        {
+            meta m;
+            m.link = vfs.symlink_status(path);
+            if (m.link.type() == fs::file_type::not_found)
+                throw os_error("cannot list", path, ENOENT);
+
+            m.status = fs::is_symlink(m.link) ? vfs.status(path) : m.link;
+            if (fs::is_regular_file(m.link))
+                m.size = vfs.file_size(path);
+            if (fs::exists(m.status))
+                m.mtime = std::chrono::duration_cast<std::chrono::seconds>(vfs.last_write_time(path).time_since_epoch()).count();
+
+            auto name = path.filename().string();
+            if (!filter.active() || filter.by_meta(name.c_str(), m.link.type(), m.size, m.mtime))
+                print(path.string(), name, m);
+            return fs::is_directory(m.link);
+        }
+        catch (const fs::filesystem_error &e)
+        {
+            fail(e);
+            return false;
+        }
+    }
+
+    void descend(const fs::path &dir)
+    {
+        if (cliex::get_vfs().native())
+        {
+            descend_native(dir.string(), nullptr, {});
+            return;
+        }
+
+        std::vector<std::string> names;
+        std::vector<std::string> subdirs;
+
+        try
+        {
+            cliex::get_vfs().list_dir(dir, [&](const std::string &name)
+            {
+                auto verdict = filter.by_name(name.c_str(), DT_UNKNOWN);
+                if (verdict == cliex::FILTER_DROP)
+                    return;
+                if (sorted)
+                    names.push_back(name);
+                else if (entry(dir / name) && recursive)
+                    subdirs.push_back(name);
+            });
+        }
+        catch (const fs::filesystem_error &e)
+        {
+            fail(e);
+        }
+
+        if (sorted)
+        {
+            std::sort(names.begin(), names.end());
+            for (auto &name : names)
+            {
+                if (entry(dir / name) && recursive)
+                    subdirs.push_back(std::move(name));
+            }
+        }
+
+        for (const auto &name : subdirs)
+            descend(dir / name);
+    }
+
+    int finish()
+    {
+        out.flush();
+        if (out.failed)
+        {
+            std::cerr << "cliex: cannot write the listing: " << strerror(out.error) << "\n";
+            status = 1;
+        }
+        return status;
+    }
+
+    void fail(const fs::filesystem_error &e)
+    {
+        std::cerr << "cliex: " << e.what() << "\n";
+        status = 1;
+    }
+
+private:
+    // one fstatat per entry, relative to the directory so the path isn't
+    // resolved again; only links need a second one for their target
+    bool entry_at(int dirfd, std::string &path, size_t dir_length, const char *name)
+    {
+        namespace stats = cliex::stats;
+
+        struct stat st;
+        int res;
+        {
+            stats::timer t{stats::CALL_SYMLINK_STATUS};
+            res = fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW);
+        }
+        path.resize(dir_length);
+        path += name;
+        if (res)
+        {
+            fail(os_error("cannot list", path, errno));
+            return false;
+        }
+
+        meta m;
+        m.link = m.status = to_status(st);
+        m.size = S_ISREG(st.st_mode) ? st.st_size : 0;
+        m.mtime = st.st_mtim.tv_sec;
+
+        if (S_ISLNK(st.st_mode))
+        {
+            struct stat target;
+            {
+                stats::timer t{stats::CALL_STATUS};
+                res = fstatat(dirfd, name, &target, 0);
+            }
+            m.status = res ? fs::file_status(fs::file_type::not_found) : to_status(target);
+            m.mtime = res ? 0 : target.st_mtim.tv_sec;
+        }
+
+        // directories the filter doesn't show are still walked
+        if (!filter.active() || filter.by_meta(name, m.link.type(), m.size, m.mtime))
+            print(path, name, m);
+        return S_ISDIR(st.st_mode);
+    }
+
+    // paths are plain strings here, an fs::path per entry costs more than
+    // its fstatat; ignored directories are never opened
+    void descend_native(const std::string &dir, const cliex::ignore::matcher *parent, std::string_view name)
+    {
+        namespace stats = cliex::stats;
+
+        int dirfd;
+        {
+            stats::timer t{stats::CALL_DIR_OPEN};
+            dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+        if (dirfd < 0)
+        {
+            fail(os_error("cannot open directory", dir, errno));
+            return;
+        }
+
+        std::shared_ptr<const cliex::ignore::matcher> ignores;
+        if (parent)
+            ignores = parent->child(name, dirfd);
+        else if (hide_ignored)
+            ignores = cliex::ignore::for_dir(dir);
+
+        std::vector<std::string> names;
+        std::vector<std::string> subdirs;
+        std::string path = dir;
+        if (path.empty() || path.back() != '/')
+            path += '/';
+        size_t dir_length = path.size();
+
+        // the buffer is free again before the subdirectories are read
+        long n;
+        while ((n = syscall(SYS_getdents64, dirfd, dents.data(), dents.size())) > 0)
+        {
+            for (long off = 0; off < n;)
+            {
+                auto d = reinterpret_cast<const dirent64 *>(dents.data() + off);
+                off += d->d_reclen;
+
+                if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
+                    continue;
+                stats::record(stats::CALL_DIR_READ, 0);
+                // names and types are checked before anything is stat'ed
+                auto verdict = filter.by_name(d->d_name, d->d_type);
+                if (verdict == cliex::FILTER_DROP || (verdict == cliex::FILTER_SKIP && !recursive))
+                    continue;
+                if (ignores && ignores->ignored(d->d_name, is_dir(dirfd, d)))
+                    continue;
+
+                if (sorted)
+                    names.emplace_back(d->d_name);
+                else if (entry_at(dirfd, path, dir_length, d->d_name) && recursive)
+                    subdirs.emplace_back(d->d_name);
+            }
+        }
+        if (n < 0)
+            fail(os_error("cannot read directory", dir, errno));
+
+        if (sorted)
+        {
+            std::sort(names.begin(), names.end());
+            for (auto &name : names)
+            {
+                if (entry_at(dirfd, path, dir_length, name.c_str()) && recursive)
+                    subdirs.push_back(std::move(name));
+            }
+        }
+        close(dirfd);
+
+        for (const auto &sub : subdirs)
+        {
+            path.resize(dir_length);
+            descend_native(path + sub, ignores.get(), sub);
+        }
+    }
+
+    // only filesystems that don't report types cost a stat
+    static bool is_dir(int dirfd, const dirent64 *d)
+    {
+        if (d->d_type != DT_UNKNOWN)
+            return d->d_type == DT_DIR;
+
+        struct stat st;
+        cliex::stats::timer t{cliex::stats::CALL_SYMLINK_STATUS};
+        return fstatat(dirfd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    // the type only depends on the name, not on the directory
+    void print(const std::string &path, const std::string &name, const meta &m)
+    {
+        auto type = fs::is_directory(m.status) ? "directory"s : cliex::get_type(name, m.status, m.link, ftypes);
+        write(path, kind(m.link.type()), m.size, cliex::get_perms(m.link.permissions()), m.mtime, type);
+    }
+
+    void write(std::string_view path, std::string_view kind, long long size, std::string_view perms, long long mtime, std::string_view type)
+    {
+        switch (f)
+        {
+        case FORMAT_JSON:
+            out.put(std::string_view("{\"path\":"));
+            put_json(out, path);
+            out.put(std::string_view(",\"kind\":\""));
+            out.put(kind);
+            out.put(std::string_view("\",\"size\":"));
+            out.put(size);
+            out.put(std::string_view(",\"perms\":\""));
+            out.put(perms);
+            out.put(std::string_view("\",\"mtime\":"));
+            out.put(mtime);
+            out.put(std::string_view(",\"type\":"));
+            put_json(out, type);
+            out.put(std::string_view("}\n"));
+            break;
+        case FORMAT_TSV:
+        case FORMAT_NUL:
+            out.put(kind);
+            out.put('\t');
+            out.put(size);
+            out.put('\t');
+            out.put(perms);
+            out.put('\t');
+            out.put(mtime);
+            out.put('\t');
+            // the path comes last, so with NUL only its end is delimited
+            if (f == FORMAT_TSV)
+            {
+                put_tsv(out, type);
+                out.put('\t');
+                put_tsv(out, path);
+                out.put('\n');
+            }
+            else
+            {
+                out.put(type);
+                out.put('\t');
+                out.put(path);
+                out.put('\0');
+            }
+            break;
+        }
+    }
+
+    writer out;
+    format f;
+    bool recursive;
+    bool sorted;
+    const cliex::entry_filter &filter;
+    bool hide_ignored;
+    std::map<std::string, std::string> &ftypes;
+    std::vector<char> dents;
+    int status = 0;
+};
+}
+
+int cliex::list::run(const std::string &path, std::vector<std::string> &opts)
+{
+    format f;
+    if (opts[INDEX_ARG_FORMAT].empty() || opts[INDEX_ARG_FORMAT] == "tsv")
+        f = FORMAT_TSV;
+    else if (opts[INDEX_ARG_FORMAT] == "json")
+        f = FORMAT_JSON;
+    else if (opts[INDEX_ARG_FORMAT] == "nul")
+        f = FORMAT_NUL;
+    else
+    {
+        std::cerr << "cliex: unknown format " << opts[INDEX_ARG_FORMAT] << ", use tsv, json or nul\n";
+        return 1;
+    }
+
+    // only by name, so a sort key isn't silently ignored
+    const auto &sort = opts[INDEX_ARG_SORT];
+    if (!sort.empty() && sort != "true" && sort != "false")
+    {
+        std::cerr << "cliex: unknown sort " << sort << ", use true or false\n";
+        return 1;
+    }
+
+    std::map<std::string, std::string> ftypes;
+    try
+    {
+        ftypes = get_all_types();
+    }
+    catch (const fs::filesystem_error &e)
+    {
+        std::cerr << "cliex: cannot read the file types: " << e.what() << "\n";
+    }
+
+    entry_filter filter{opts};
+    lister l(f, opts[INDEX_ARG_RECURSIVE] == "true", sort == "true", filter,
+             opts[INDEX_ARG_HIDE_IGNORED] == "true" && get_vfs().native(), ftypes);
+    try
+    {
+        // like ls, a directory is listed and anything else is the only entry
+        if (fs::is_directory(get_vfs().status(path)))
+            l.descend(path);
+        else
+            l.entry(path);
+    }
+    catch (const fs::filesystem_error &e)
+    {
+        l.fail(e);
+    }
+    return l.finish();
+}
@@ -30,6 +30,7 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 
 #include <iterator>
 #include <algorithm>
@@ -37,14 +38,37 @@
 #include <experimental/filesystem>
 
 #include <string.h>
+#include <locale.h>
 #include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <pwd.h>
 
-#include <menu.h>
 #include <ncurses.h>
 
 #include "cliex.hpp"
+#include "stats.hpp"
+#include "script.hpp"
+#include "vfs.hpp"
+#include "perf.hpp"
+#include "profiler.hpp"
+#include "pool.hpp"
+#include "aio.hpp"
+#include "frame.hpp"
+#include "cache.hpp"
+#include "query.hpp"
+#include "width.hpp"
+#include "miller.hpp"
+#include "tree.hpp"
+#include "list.hpp"
+#include "daemon.hpp"
+#include "shm.hpp"
+#include "git.hpp"
+#include "owners.hpp"
+#include "info.hpp"
+#include "filter.hpp"
 
 namespace fs = std::experimental::filesystem;
 using std::literals::string_literals::operator""s;
@@ -91,11 +115,23 @@ std::vector<std::string> split(const std::string &s)
 std::vector<std::string> parse_argv(int argc, char const *argv[])
 {
     std::vector<std::string> args(argv, argv + argc);
-    std::vector<std::string> opts(10);
+    std::vector<std::string> opts(INDEX_ARG_COUNT);
     size_t pos_equal;
     std::string opt, value;
+    bool list_next = false;
     for (auto &a : args)
     {
+        // --list also takes its path as the next argument
+        if (list_next)
+        {
+            list_next = false;
+            if (a.rfind("--", 0) != 0)
+            {
+                opts[INDEX_ARG_LIST] = a;
+                continue;
+            }
+        }
+
         pos_equal = a.find("=");
         if (pos_equal != a.npos)
         {
@@ -105,93 +141,912 @@ std::vector<std::string> parse_argv(int argc, char const *argv[])
                 opts[INDEX_ARG_HIDDEN_FILES] = value;
             else if (opt == "--max_columns")
                 opts[INDEX_ARG_MAX_COLUMNS] = value;
+            else if (opt == "--stats")
+                opts[INDEX_ARG_STATS] = value;
+            else if (opt == "--debug_overlay")
+                opts[INDEX_ARG_DEBUG_OVERLAY] = value;
+            else if (opt == "--script")
+                opts[INDEX_ARG_SCRIPT] = value;
+            else if (opt == "--vfs")
+                opts[INDEX_ARG_VFS] = value;
+            else if (opt == "--synthetic")
+                opts[INDEX_ARG_SYNTHETIC] = value;
+            else if (opt == "--vfs_latency")
+                opts[INDEX_ARG_VFS_LATENCY] = value;
+            else if (opt == "--vfs_jitter")
+                opts[INDEX_ARG_VFS_JITTER] = value;
+            else if (opt == "--vfs_failures")
+                opts[INDEX_ARG_VFS_FAILURES] = value;
+            else if (opt == "--rss_budget")
+                opts[INDEX_ARG_RSS_BUDGET] = value;
+            else if (opt == "--perf")
+                opts[INDEX_ARG_PERF] = value;
+            else if (opt == "--profile")
+                opts[INDEX_ARG_PROFILE] = value;
+            else if (opt == "--sync_output")
+                opts[INDEX_ARG_SYNC_OUTPUT] = value;
+            else if (opt == "--miller")
+                opts[INDEX_ARG_MILLER] = value;
+            else if (opt == "--tree")
+                opts[INDEX_ARG_TREE] = value;
+            else if (opt == "--list")
+                opts[INDEX_ARG_LIST] = value;
+            else if (opt == "--format")
+                opts[INDEX_ARG_FORMAT] = value;
+            else if (opt == "--recursive")
+                opts[INDEX_ARG_RECURSIVE] = value;
+            else if (opt == "--sort")
+                opts[INDEX_ARG_SORT] = value;
+            else if (opt == "--daemon")
+                opts[INDEX_ARG_DAEMON] = value;
+            else if (opt == "--daemon_socket")
+                opts[INDEX_ARG_DAEMON_SOCKET] = value;
+            else if (opt == "--use_daemon")
+                opts[INDEX_ARG_USE_DAEMON] = value;
+            else if (opt == "--shared_cache")
+                opts[INDEX_ARG_SHARED_CACHE] = value;
+            else if (opt == "--git_status")
+                opts[INDEX_ARG_GIT_STATUS] = value;
+            else if (opt == "--hide_ignored")
+                opts[INDEX_ARG_HIDE_IGNORED] = value;
+            else if (opt == "--type")
+                opts[INDEX_ARG_TYPE] = value;
+            else if (opt == "--name")
+                opts[INDEX_ARG_NAME] = value;
+            else if (opt == "--min_size")
+                opts[INDEX_ARG_MIN_SIZE] = value;
+            else if (opt == "--max_size")
+                opts[INDEX_ARG_MAX_SIZE] = value;
+            else if (opt == "--newer")
+                opts[INDEX_ARG_NEWER] = value;
+            else if (opt == "--older")
+                opts[INDEX_ARG_OLDER] = value;
+            else if (opt == "--time_style")
+                opts[INDEX_ARG_TIME_STYLE] = value;
+        }
+        else if (a == "--stats")
+            opts[INDEX_ARG_STATS] = "true";
+        else if (a == "--debug_overlay")
+            opts[INDEX_ARG_DEBUG_OVERLAY] = "true";
+        else if (a == "--perf")
+            opts[INDEX_ARG_PERF] = "true";
+        else if (a == "--miller")
+            opts[INDEX_ARG_MILLER] = "true";
+        else if (a == "--tree")
+            opts[INDEX_ARG_TREE] = "true";
+        else if (a == "--list")
+        {
+            opts[INDEX_ARG_LIST] = ".";
+            list_next = true;
         }
+        else if (a == "--recursive")
+            opts[INDEX_ARG_RECURSIVE] = "true";
+        else if (a == "--sort")
+            opts[INDEX_ARG_SORT] = "true";
+        else if (a == "--daemon")
+            opts[INDEX_ARG_DAEMON] = "true";
+        else if (a == "--hide_ignored")
+            opts[INDEX_ARG_HIDE_IGNORED] = "true";
     }
     return opts;
 }
 
+void setup_vfs(std::vector<std::string> &opts)
+{
+    std::unique_ptr<cliex::vfs> vfs;
+    int latency, jitter;
+    double failures;
+
+    if (opts[INDEX_ARG_VFS] == "memory")
+    {
+        size_t entries;
+        try
+        {
+            entries = std::stoul(opts[INDEX_ARG_SYNTHETIC]);
+        }
+        catch (...)
+        {
+            entries = DEFAULT_SYNTHETIC_ENTRIES;
+        }
+
+        auto memory = new cliex::memory_vfs;
+        memory->add_synthetic(home_dir, entries);
+        vfs.reset(memory);
+    }
+    else
+    {
+        vfs.reset(new cliex::local_vfs);
+    }
+
+    try
+    {
+        latency = std::stoi(opts[INDEX_ARG_VFS_LATENCY]);
+    }
+    catch (...)
+    {
+        latency = 0;
+    }
+
+    try
+    {
+        jitter = std::stoi(opts[INDEX_ARG_VFS_JITTER]);
+    }
+    catch (...)
+    {
+        jitter = 0;
+    }
+
+    try
+    {
+        failures = std::stod(opts[INDEX_ARG_VFS_FAILURES]);
+    }
+    catch (...)
+    {
+        failures = 0;
+    }
+
+    if (latency > 0 || jitter > 0 || failures > 0)
+        vfs.reset(new cliex::latency_vfs(std::move(vfs), latency, jitter, failures));
+
+    cliex::set_vfs(std::move(vfs));
+}
+
+bool input_pending()
+{
+    pollfd p = {STDIN_FILENO, POLLIN, 0};
+    return poll(&p, 1, 0) > 0;
+}
+
+// what a tab shows while another one is active
+struct tab
+{
+    fs::path dir;
+    std::shared_ptr<cliex::listing> shown;
+    std::shared_ptr<cliex::listing> pending;
+    size_t cursor;
+    // the query shown is the result of and the listing it ran on
+    std::string query;
+    std::shared_ptr<cliex::listing> unfiltered;
+};
+
+volatile sig_atomic_t resized = 0;
+
+void on_winch(int)
+{
+    resized = 1;
+    cliex::aio::notify();
+}
+
+// the script sets the size itself, a terminal reports it
+void terminal_size(int &rows, int &cols)
+{
+    if (cliex::script::size(rows, cols))
+        return;
+
+    winsize ws;
+    rows = LINES;
+    cols = COLS;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col)
+    {
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+    }
+}
+
+const char *key_action(int c)
+{
+    switch (c)
+    {
+    case KEY_DOWN:
+        return "down";
+    case KEY_UP:
+        return "up";
+    case KEY_RIGHT:
+        return "right";
+    case KEY_LEFT:
+        return "left";
+    case KEY_NPAGE:
+        return "npage";
+    case KEY_PPAGE:
+        return "ppage";
+    case 0xA:
+        return "enter";
+    case KEY_BACKSPACE:
+        return "backspace";
+    case KEY_RESIZE:
+        return "resize";
+    case '\t':
+        return "next_tab";
+    case KEY_BTAB:
+        return "prev_tab";
+    case 't':
+        return "new_tab";
+    case 'w':
+        return "close_tab";
+    case 'm':
+        return "miller";
+    case 'T':
+        return "tree";
+    case '/':
+        return "query";
+    default:
+        return "other";
+    }
+}
+
 int main(int argc, char const *argv[])
 {
+    setlocale(LC_CTYPE, "");
     auto opts = parse_argv(argc, argv);
-    auto ftypes = cliex::get_all_types();
+    bool scripted = !opts[INDEX_ARG_SCRIPT].empty();
+    if (scripted && !cliex::script::load(opts[INDEX_ARG_SCRIPT]))
+    {
+        std::cerr << "cliex: cannot read key script " << opts[INDEX_ARG_SCRIPT] << "\n";
+        return 1;
+    }
+    auto time_style = cliex::timestamp::STYLE_ISO;
+    try
+    {
+        cliex::entry_filter check{opts};
+        time_style = cliex::timestamp::parse_style(opts[INDEX_ARG_TIME_STYLE]);
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << "cliex: " << e.what() << "\n";
+        return 1;
+    }
+    if (!opts[INDEX_ARG_PROFILE].empty() && !cliex::profiler::start(opts[INDEX_ARG_PROFILE]))
+        std::cerr << "cliex: cannot start the profiler\n";
+    cliex::pool::start();
+    cliex::aio::init();
 
-    std::vector<std::string> choices{};
-    std::string selected;
-    fs::path current_dir(home_dir);
-    cliex::get_dir_content(current_dir.string().c_str(), choices, current_dir, opts);
+    setup_vfs(opts);
+    if (opts[INDEX_ARG_PERF] == "true")
+        cliex::perf::enable();
+    cliex::stats::mark_phase("options");
+
+    // --list writes the listing to stdout and the daemon serves listings,
+    // neither sets up the terminal
+    auto socket = opts[INDEX_ARG_DAEMON_SOCKET].empty() ? DAEMON_SOCKET : opts[INDEX_ARG_DAEMON_SOCKET];
+    bool daemon = opts[INDEX_ARG_DAEMON] == "true" || fs::path(argv[0]).filename() == "cliexd";
+    if (!opts[INDEX_ARG_LIST].empty() || daemon)
+    {
+        int status = daemon ? cliex::daemon::serve(socket) : cliex::list::run(opts[INDEX_ARG_LIST], opts);
+        cliex::pool::stop();
+
+        if (!opts[INDEX_ARG_PROFILE].empty() && !cliex::profiler::stop())
+            std::cerr << "cliex: cannot write the profile to " << opts[INDEX_ARG_PROFILE] << "\n";
+        if (opts[INDEX_ARG_STATS] == "true")
+            std::cerr << cliex::stats::dump();
+        if (opts[INDEX_ARG_PERF] == "true")
+            std::cerr << cliex::perf::dump();
+        return status;
+    }
+
+    if (opts[INDEX_ARG_USE_DAEMON] != "false")
+        cliex::daemon::use(socket);
+    if (opts[INDEX_ARG_SHARED_CACHE] != "false")
+        cliex::shm::open();
 
-    std::sort(choices.begin(), choices.end(), [](const std::string &a, const std::string &b)
+    // the type table and the first listing load while the UI comes up,
+    // the types are waited for at the first type lookup
+    std::map<std::string, std::string> ftypes;
+    auto types_loading = cliex::pool::async(cliex::PRIORITY_VISIBLE, []
     {
-        return a < b;
+        auto types = cliex::get_all_types();
+        cliex::stats::mark_phase("types");
+        return types;
     });
 
-    std::vector<ITEM *> items;
+    std::shared_ptr<cliex::listing> shown;
+    std::string selected;
+    fs::path current_dir(home_dir);
+
+    // listings load in the background, the one the user asked for last is
+    // shown as soon as it's complete
+    auto pending = cliex::cache::get(current_dir, opts);
+
+    // the active tab is current_dir, shown, pending and the grid, its entry
+    // here is only up to date while another tab is active
+    std::vector<tab> tabs(1);
+    size_t active = 0;
+
+    // what is typed after '/', the query of the active tab and the line
+    // below the file information that shows either
+    bool editing = false;
+    std::string typed;
+    std::string active_query;
+    std::shared_ptr<cliex::listing> unfiltered;
+    std::string prompt_line;
+
     WINDOW *main, *property_win;
-    MENU *menu;
+    cliex::file_grid grid;
+    cliex::miller_view miller;
+    cliex::tree_view tree;
+    bool tree_mode = opts[INDEX_ARG_TREE] == "true";
+    bool miller_mode = !tree_mode && opts[INDEX_ARG_MILLER] == "true";
+
+    SCREEN *screen = nullptr;
+    std::string screen_dump;
 
     int c;
     bool fin = false;
+    bool overlay = DEBUG || opts[INDEX_ARG_DEBUG_OVERLAY] == "true";
+
+    if (scripted)
+        screen = cliex::script::open_screen();
+    else
+        initscr();
 
-    initscr();
+    // replaces the handler of ncurses, the loop resizes between frames
+    if (!scripted)
+    {
+        struct sigaction sa = {};
+        sigemptyset(&sa.sa_mask);
+        sa.sa_handler = on_winch;
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGWINCH, &sa, nullptr);
+    }
     clear();
     noecho();
     curs_set(0);
     cbreak();
     nl();
     keypad(stdscr, 1);
+    cliex::frame::init(scripted ? cliex::script::output_fd() : STDOUT_FILENO, opts[INDEX_ARG_SYNC_OUTPUT]);
 
     main = cliex::add_win(MAIN_HEIGHT, MAIN_WIDTH, 1, 1, "***** CLIEx *****");
-    menu = cliex::add_file_menu(main, choices, items, current_dir, opts);
-
     property_win = cliex::add_win(PROPERTY_WIN_HEIGHT, PROPERTY_WIN_WIDTH, 1, MAIN_WIDTH + 2, "File Information");
 
     mvaddstr(LINES - 2, SUB_WIDTH + 7, ("Quit by pressing q."));
+    mvwaddstr(main, 3, 3, "Loading...");
 
-    refresh();
-    wrefresh(main);
-    wrefresh(property_win);
+    cliex::frame::touch(stdscr);
+    cliex::frame::touch(main);
+    cliex::frame::touch(property_win);
+    cliex::frame::present();
+    cliex::stats::mark_phase("first paint");
 
-    while ((c = getch()) != 113 && !fin)
+    cliex::aio::wait_idle();
+    cliex::stats::mark_phase("listing");
+    if (!pending->error.empty())
+        cliex::show_error(property_win, pending->error);
+    shown = pending;
+    pending.reset();
+
+    wmove(main, 3, 3);
+    wclrtoeol(main);
+    box(main, 0, 0);
+
+    // the grid keeps pointers into the listing it was given, while the tree
+    // is shown it isn't used at all
+    auto place_views = [&]
     {
-        auto current_dir_status = fs::status(current_dir);
+        if (tree_mode)
+        {
+            miller.close();
+            grid.close();
+            tree.place(main, SUB_HEIGHT, SUB_WIDTH, 3, 3);
+        }
+        else if (miller_mode)
+        {
+            tree.close();
+            miller.place(main, grid, SUB_HEIGHT, SUB_WIDTH, 3, 3);
+        }
+        else
+        {
+            tree.close();
+            miller.close();
+            grid.limit(UINT_MAX);
+            grid.place(main, SUB_HEIGHT, SUB_WIDTH, 3, 3);
+        }
+    };
+
+    // the grid only makes room for git marks inside a repository
+    bool git_status = opts[INDEX_ARG_GIT_STATUS] != "false";
+    auto show_marks = [&]
+    {
+        if (!git_status)
+            return;
+        if (cliex::git::repository(current_dir))
+        {
+            grid.marks([&](size_t i)
+            {
+                return cliex::git::mark(*shown, i);
+            });
+        }
+        else
+        {
+            grid.marks(nullptr);
+        }
+    };
+    if (git_status)
+        tree.marks(cliex::git::mark);
+
+    auto show_listing = [&]
+    {
+        if (git_status)
+            cliex::git::refresh(*shown);
+        if (tree_mode)
+            cliex::show_tree(main, tree, shown);
+        else
+            cliex::show_dir(main, grid, shown->entries, shown->widths, current_dir, opts);
+        show_marks();
+    };
+
+    place_views();
+    show_listing();
+    cliex::stats::set_footprint(cliex::get_footprint(shown->entries, shown->widths, grid, ftypes));
+
+    cliex::frame::touch(main);
+    cliex::frame::present();
+    cliex::stats::mark_phase("layout");
+
+    auto redraw = [&]
+    {
+        if (types_loading.valid())
+            ftypes = types_loading.get();
+
+        fs::path dir = current_dir;
+        if (tree_mode)
+        {
+            tree.draw();
+            selected = tree.selected();
+            dir = tree.selected_dir();
+        }
+        else
+        {
+            grid.draw();
+            selected = grid.selected();
+        }
+
+        try
+        {
+            cliex::show_file_info(property_win, selected, dir / selected, ftypes, time_style);
+        }
+        catch (const fs::filesystem_error &e)
+        {
+            cliex::show_error(property_win, e.what());
+        }
+
+        if (overlay)
+        {
+            cliex::stats::draw_overlay(property_win, DEBUG_OVERLAY_Y);
+            cliex::frame::touch(property_win);
+        }
+
+        cliex::frame::touch(main);
+    };
+
+    // in the title row, up to the path
+    auto draw_tabs = [&]
+    {
+        if (tabs.size() < 2)
+            return;
+
+        int x = TAB_BAR_X;
+        int end = MAIN_WIDTH - cliex::display_width(current_dir.string()) - 3;
+        for (size_t i = 0; i < tabs.size() && x < end; i++)
+        {
+            fs::path dir = i == active ? current_dir : tabs[i].dir;
+            std::string label = " " + std::to_string(i + 1) + " " + (dir == ROOT_DIR ? dir.string() : dir.filename().string()) + " ";
+            label.resize(cliex::display_prefix(label, std::min(TAB_LABEL_WIDTH, end - x)));
+
+            if (i == active)
+                wattron(main, A_REVERSE);
+            mvwaddstr(main, 1, x, label.c_str());
+            wattroff(main, A_REVERSE);
+            x += cliex::display_width(label) + 1;
+        }
+    };
+
+    auto adopt = [&]
+    {
+        mvwhline(main, 1, MAIN_WIDTH - LOADING_WIDTH, ' ', LOADING_WIDTH - 1);
+        if (pending->error.empty())
+        {
+            shown = pending;
+            current_dir = shown->dir;
+
+            show_listing();
+            draw_tabs();
+            cliex::stats::set_footprint(cliex::get_footprint(shown->entries, shown->widths, grid, ftypes));
+            redraw();
+        }
+        else
+        {
+            cliex::show_error(property_win, pending->error);
+            cliex::frame::touch(main);
+        }
+        pending.reset();
+    };
+
+    // the end of the line stays visible while typing
+    auto draw_prompt = [&](std::string line)
+    {
+        prompt_line = line;
+        int x = SUB_WIDTH + 7;
+        int width = COLS - x - 1;
+        if (width <= 0)
+            return;
+
+        while (!line.empty() && static_cast<int>(cliex::display_width(line)) > width)
+        {
+            line.erase(0, 1);
+            while (!line.empty() && (line[0] & 0xC0) == 0x80)
+                line.erase(0, 1);
+        }
+        mvhline(LINES - 3, x, ' ', width);
+        mvaddstr(LINES - 3, x, line.c_str());
+        cliex::frame::touch(stdscr);
+    };
+
+    // a query always runs on the listing that was shown before the first
+    // one, an empty query shows that listing again
+    auto submit_query = [&]
+    {
+        auto base = unfiltered ? unfiltered : shown;
+        if (typed.empty())
+        {
+            active_query.clear();
+            draw_prompt("");
+            if (!unfiltered)
+                return;
+
+            pending = unfiltered;
+            unfiltered.reset();
+            adopt();
+            return;
+        }
+
+        std::shared_ptr<const cliex::query> q;
+        try
+        {
+            q = std::make_shared<const cliex::query>(typed);
+        }
+        catch (const std::invalid_argument &e)
+        {
+            draw_prompt(std::string("query: ") + e.what());
+            return;
+        }
+
+        unfiltered = base;
+        active_query = typed;
+        draw_prompt("/" + active_query);
+        pending = cliex::query_listing(base, q);
+        mvwaddstr(main, 1, MAIN_WIDTH - LOADING_WIDTH, "Loading...");
+        cliex::frame::touch(main);
+    };
+
+    auto edit_query = [&](int key)
+    {
+        switch (key)
+        {
+        case 27:
+            editing = false;
+            draw_prompt(active_query.empty() ? "" : "/" + active_query);
+            return;
+        case 0xA:
+            editing = false;
+            submit_query();
+            return;
+        case KEY_BACKSPACE:
+        case 127:
+        case 8:
+            while (!typed.empty() && (typed.back() & 0xC0) == 0x80)
+                typed.pop_back();
+            if (!typed.empty())
+                typed.pop_back();
+            break;
+        default:
+            // multibyte characters arrive one byte at a time
+            if (key >= ' ' && key < 256 && key != 127)
+                typed += static_cast<char>(key);
+            break;
+        }
+        draw_prompt("/" + typed + "_");
+    };
+
+    auto save_tab = [&]
+    {
+        tabs[active] = {current_dir, shown, pending, grid.cursor(), active_query, unfiltered};
+    };
+
+    // everything a tab shows is in memory, unless its listing is still loading
+    auto open_tab = [&](size_t i)
+    {
+        active = i;
+        current_dir = tabs[i].dir;
+        shown = tabs[i].shown;
+        pending = tabs[i].pending;
+        active_query = tabs[i].query;
+        unfiltered = tabs[i].unfiltered;
+        draw_prompt(active_query.empty() ? "" : "/" + active_query);
+
+        if (pending && pending->done)
+        {
+            adopt();
+            return;
+        }
+
+        mvwhline(main, 1, MAIN_WIDTH - LOADING_WIDTH, ' ', LOADING_WIDTH - 1);
+        show_listing();
+        if (!tree_mode)
+            grid.select(tabs[i].cursor);
+        if (pending)
+            mvwaddstr(main, 1, MAIN_WIDTH - LOADING_WIDTH, "Loading...");
+        draw_tabs();
+        cliex::stats::set_footprint(cliex::get_footprint(shown->entries, shown->widths, grid, ftypes));
+        redraw();
+    };
+
+    // the cursor of the grid stays where it was, unless the tree was shown
+    auto switch_view = [&](bool was_tree)
+    {
+        size_t cursor = grid.cursor();
+        place_views();
+        show_listing();
+        if (!tree_mode && !was_tree)
+            grid.select(cursor);
+        if (miller.active())
+            miller.follow(current_dir, grid.selected(), opts);
+        miller.draw();
+        draw_tabs();
+        if (pending)
+            mvwaddstr(main, 1, MAIN_WIDTH - LOADING_WIDTH, "Loading...");
+        redraw();
+    };
+
+    auto tree_key = [&](int key)
+    {
+        switch (key)
+        {
+        case KEY_DOWN:
+            tree.down();
+            return true;
+        case KEY_UP:
+            tree.up();
+            return true;
+        case KEY_NPAGE:
+            tree.page_down();
+            return true;
+        case KEY_PPAGE:
+            tree.page_up();
+            return true;
+        case KEY_RIGHT:
+            tree.expand(opts);
+            return true;
+        case KEY_LEFT:
+            tree.collapse();
+            return true;
+        default:
+            return false;
+        }
+    };
+
+    // a watched directory has changed, the cursors stay on their entries
+    cliex::cache::on_change([&](const cliex::listing &l, size_t index, bool inserted)
+    {
+        auto follow = [index, inserted](size_t cursor)
+        {
+            if (inserted && index <= cursor)
+                return cursor + 1;
+            if (!inserted && index < cursor)
+                return cursor - 1;
+            return cursor;
+        };
+
+        for (size_t i = 0; i < tabs.size(); i++)
+        {
+            if (i != active && tabs[i].shown.get() == &l)
+                tabs[i].cursor = follow(tabs[i].cursor);
+        }
+
+        if (miller.shows(l))
+            miller.draw();
+        if (tree_mode)
+        {
+            if (tree.changed(l, index, inserted))
+                redraw();
+            return;
+        }
+        if (shown.get() != &l)
+            return;
+
+        size_t cursor = follow(grid.cursor());
+        grid.changed(index);
+        grid.select(cursor);
+        redraw();
+    });
+
+    while (!fin)
+    {
+        // keys that are already queued are handled before anything is drawn,
+        // so a burst of input costs a single frame
+        if (scripted || !input_pending())
+        {
+            if (miller.active())
+                miller.follow(current_dir, grid.selected(), opts);
+            cliex::frame::present();
+        }
+
+        // the script waits for all loading to finish, so its timings include it
+        bool key_ready = true;
+        if (scripted)
+            cliex::aio::wait_idle();
+        else
+            key_ready = cliex::aio::wait(STDIN_FILENO);
+
+        if (pending && pending->done)
+            adopt();
+        miller.update();
+        if (tree.window() && tree.update())
+            tree.draw();
+        if (git_status && cliex::git::changed())
+        {
+            show_marks();
+            redraw();
+        }
+        if (cliex::owners::changed())
+            redraw();
+        if (cliex::info::changed())
+            redraw();
+
+        if (!key_ready && !resized)
+            continue;
+        if (resized)
+        {
+            resized = 0;
+            c = KEY_RESIZE;
+        }
+        else if (scripted && !cliex::script::next_key(c))
+            break;
+        else if ((scripted ? c : (c = getch())) == 113 && !editing)
+            break;
+
+        cliex::stats::begin_action(editing ? "query" : key_action(c));
+        fs::path last_dir = current_dir;
+
+        if (editing && c != KEY_RESIZE)
+        {
+            edit_query(c);
+            continue;
+        }
+
+        if (tree_mode && tree_key(c))
+        {
+            redraw();
+            continue;
+        }
 
         switch (c)
         {
         case KEY_DOWN:
-            menu_driver(menu, REQ_DOWN_ITEM);
+            grid.down();
             break;
         case KEY_UP:
-            menu_driver(menu, REQ_UP_ITEM);
+            grid.up();
             break;
         case KEY_RIGHT:
-            menu_driver(menu, REQ_RIGHT_ITEM);
+            grid.right();
             break;
         case KEY_LEFT:
-            menu_driver(menu, REQ_LEFT_ITEM);
+            grid.left();
             break;
         case KEY_NPAGE:
-            menu_driver(menu, REQ_SCR_DPAGE);
+            grid.page_down();
             break;
         case KEY_PPAGE:
-            menu_driver(menu, REQ_SCR_UPAGE);
+            grid.page_up();
             break;
+
+        case KEY_RESIZE:
+        {
+            // everything is rebuilt from what is in memory, the listing
+            // isn't read again and the file information isn't looked up
+            int rows, cols;
+            terminal_size(rows, cols);
+            resize_term(rows, cols);
+
+            miller.close();
+            grid.close();
+            tree.close();
+            cliex::frame::forget(main);
+            delwin(main);
+            erase();
+
+            WINDOW *old_property = property_win;
+            main = cliex::add_win(MAIN_HEIGHT, MAIN_WIDTH, 1, 1, "***** CLIEx *****");
+            property_win = cliex::add_win(PROPERTY_WIN_HEIGHT, PROPERTY_WIN_WIDTH, 1, MAIN_WIDTH + 2, "File Information");
+
+            int h = std::min(getmaxy(old_property), getmaxy(property_win)) - 2;
+            int w = std::min(getmaxx(old_property), getmaxx(property_win)) - 2;
+            if (h > 0 && w > 0)
+                copywin(old_property, property_win, 1, 1, 1, 1, h, w, FALSE);
+            box(property_win, 0, 0);
+            cliex::frame::forget(old_property);
+            delwin(old_property);
+
+            mvaddstr(LINES - 2, SUB_WIDTH + 7, ("Quit by pressing q."));
+            draw_prompt(prompt_line);
+            place_views();
+            if (tree_mode)
+                cliex::reflow(main, tree, current_dir);
+            else
+                cliex::reflow(main, grid, current_dir);
+            miller.draw();
+            draw_tabs();
+            if (pending)
+                mvwaddstr(main, 1, MAIN_WIDTH - LOADING_WIDTH, "Loading...");
+
+            cliex::frame::touch(stdscr);
+            cliex::frame::touch(main);
+            cliex::frame::touch(property_win);
+            continue;
+        }
+
+        case 't':
+            save_tab();
+            tabs.insert(tabs.begin() + active + 1, tabs[active]);
+            tabs[active + 1].pending.reset();
+            open_tab(active + 1);
+            continue;
+
+        case 'w':
+            if (tabs.size() < 2)
+                break;
+            tabs.erase(tabs.begin() + active);
+            open_tab(std::min(active, tabs.size() - 1));
+            continue;
+
+        case '\t':
+        case KEY_BTAB:
+            if (tabs.size() < 2)
+                break;
+            save_tab();
+            open_tab((active + (c == '\t' ? 1 : tabs.size() - 1)) % tabs.size());
+            continue;
+
+        case '/':
+            editing = true;
+            typed = active_query;
+            draw_prompt("/" + typed + "_");
+            continue;
+
+        case 'm':
+        case 'T':
+        {
+            bool was_tree = tree_mode;
+            if (c == 'm')
+                miller_mode = tree_mode || !miller_mode;
+            else
+                miller_mode = false;
+            tree_mode = c == 'T' && !tree_mode;
+            switch_view(was_tree);
+            continue;
+        }
+
         case 0xA:
-            selected = item_name(current_item(menu));
+        {
+            // in the tree, the entry may be further down
+            fs::path dir = tree_mode ? tree.selected_dir() : current_dir;
+            selected = tree_mode ? tree.selected() : grid.selected();
             if (selected == "..")
             {
-                current_dir = current_dir.parent_path();
+                current_dir = dir.parent_path();
                 goto change_dir;
             }
-            else if (*(selected.end()-1) == '/')
+            else if (!selected.empty() && *(selected.end()-1) == '/')
             {
                 selected.erase(selected.end()-1);
-                current_dir = current_dir / selected;
+                current_dir = dir / selected;
                 goto change_dir;
             }
             break;
+        }
 
         case KEY_BACKSPACE:
-            selected = item_name(current_item(menu));
+            selected = tree_mode ? tree.selected() : grid.selected();
             if (current_dir != ROOT_DIR)
             {
                 current_dir = current_dir.parent_path();
@@ -200,29 +1055,101 @@ int main(int argc, char const *argv[])
             break;
 
 change_dir:
-            if (fs::is_directory(fs::status(current_dir)))
+            // the current listing stays until the new one is complete, a
+            // newer request replaces an older one that is still loading;
+            // the query only applied to the directory it ran on
+            if (!active_query.empty())
             {
-                choices.clear();
-                items.clear();
-                cliex::clear_menu(menu, items);
-
-                cliex::get_dir_content(current_dir.string().c_str(), choices, current_dir, opts);
-                menu = cliex::add_file_menu(main, choices, items, current_dir, opts);
-                selected = item_name(current_item(menu));
+                active_query.clear();
+                unfiltered.reset();
+                draw_prompt("");
+            }
+            pending = cliex::cache::get(current_dir, opts);
+            current_dir = last_dir;
+            if (pending->done)
+            {
+                adopt();
+                continue;
             }
+
+            mvwaddstr(main, 1, MAIN_WIDTH - LOADING_WIDTH, "Loading...");
+            cliex::frame::touch(main);
+            continue;
         }
 
-        selected = item_name(current_item(menu));
-        cliex::show_file_info(property_win, selected, current_dir / selected, ftypes);
+        redraw();
+    }
 
-        wrefresh(main);
-        refresh();
+    if (scripted)
+    {
+        // what arrived after the last key is drawn before the dump
+        for (bool again = true; again;)
+        {
+            cliex::aio::wait_idle();
+            again = pending && pending->done;
+            if (again)
+                adopt();
+            if (git_status && cliex::git::changed())
+            {
+                show_marks();
+                again = true;
+            }
+            if (cliex::owners::changed())
+                again = true;
+            if (cliex::info::changed())
+                again = true;
+            if (again)
+                redraw();
+        }
+        cliex::frame::present();
+        screen_dump = cliex::script::screen_text();
     }
 
-    cliex::clear_menu(menu, items);
+    miller.close();
+    grid.close();
+    tree.close();
+    cliex::frame::forget(main);
+    cliex::frame::forget(property_win);
     delwin(main);
     delwin(property_win);
     endwin();
 
+    if (scripted)
+    {
+        delscreen(screen);
+        cliex::script::report(std::cout);
+        std::cout << screen_dump;
+    }
+
+    cliex::pool::stop();
+
+    if (!opts[INDEX_ARG_PROFILE].empty() && !cliex::profiler::stop())
+        std::cerr << "cliex: cannot write the profile to " << opts[INDEX_ARG_PROFILE] << "\n";
+
+    if (opts[INDEX_ARG_STATS] == "true")
+        std::cerr << cliex::stats::dump();
+    if (opts[INDEX_ARG_PERF] == "true")
+        std::cerr << cliex::perf::dump();
+
+    if (!opts[INDEX_ARG_RSS_BUDGET].empty())
+    {
+        long budget_mb;
+        try
+        {
+            budget_mb = std::stol(opts[INDEX_ARG_RSS_BUDGET]);
+        }
+        catch (...)
+        {
+            budget_mb = 0;
+        }
+
+        long peak_mb = cliex::stats::peak_rss_kb() / 1024;
+        if (budget_mb > 0 && peak_mb > budget_mb)
+        {
+            std::cerr << "cliex: peak RSS of " << peak_mb << " MB exceeds the budget of " << budget_mb << " MB\n";
+            return 3;
+        }
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,171 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * miller.cpp
+ *
+ * follow() is only called once the keys that are already queued are handled,
+ * so holding a key down doesn't start a prefetch for every entry it passes.
+ * A prefetch never blocks the main thread, even on a slow mount; moving on
+ * cancels it.
+*/
+
+#include <string>
+#include <vector>
+
+#include <algorithm>
+#include <memory>
+
+#include <ncurses.h>
+
+#include "miller.hpp"
+#include "cache.hpp"
+#include "frame.hpp"
+#include "width.hpp"
+
+cliex::miller_view::~miller_view()
+{
+    close();
+}
+
+void cliex::miller_view::place(WINDOW *win, file_grid &grid, int height, int width, int starty, int startx)
+{
+    close();
+
+    // the gaps between the columns belong to the side columns
+    int parent_width = width / MILLER_PARENT_SHARE;
+    int middle_width = (width - parent_width) / 2;
+    parent.win = derwin(win, height, parent_width, starty, startx);
+    child.win = derwin(win, height, width - parent_width - middle_width, starty, startx + parent_width + middle_width);
+
+    grid.place(win, height, middle_width, starty, startx + parent_width);
+    grid.limit(1);
+
+    parent.drawn_done = child.drawn_done = false;
+}
+
+void cliex::miller_view::close()
+{
+    for (auto c : {&parent, &child})
+    {
+        if (c->win)
+        {
+            frame::forget(c->win);
+            delwin(c->win);
+        }
+        c->win = nullptr;
+    }
+}
+
+void cliex::miller_view::show(column &c, const fs::path &dir, const std::vector<std::string> &opts)
+{
+    if (c.shown && c.shown->dir == dir)
+        return;
+
+    cache::cancel(c.shown);
+    c.shown = dir.empty() ? nullptr : cache::prefetch(dir, opts);
+    c.drawn_done = false;
+}
+
+void cliex::miller_view::follow(const fs::path &dir, const std::string &selected, const std::vector<std::string> &opts)
+{
+    if (!active() || (dir == current && selected == under_cursor))
+        return;
+
+    current = dir;
+    under_cursor = selected;
+
+    show(parent, dir == ROOT_DIR ? fs::path() : dir.parent_path(), opts);
+    bool is_dir = !selected.empty() && selected.back() == '/';
+    show(child, is_dir ? dir / selected.substr(0, selected.size() - 1) : fs::path(), opts);
+    draw();
+}
+
+bool cliex::miller_view::update()
+{
+    bool redraw = false;
+    for (auto c : {&parent, &child})
+        redraw |= c->shown && c->shown->done && !c->drawn_done;
+
+    if (redraw && active())
+        draw();
+    return redraw;
+}
+
+bool cliex::miller_view::shows(const listing &l) const
+{
+    return parent.shown.get() == &l || child.shown.get() == &l;
+}
+
+void cliex::miller_view::draw()
+{
+    if (!active())
+        return;
+
+    draw(parent, current.filename().string() + "/", 0);
+    draw(child, "", GRID_GAP);
+}
+
+void cliex::miller_view::draw(column &c, const std::string &mark, int indent)
+{
+    werase(c.win);
+    frame::touch(c.win);
+    c.drawn_done = c.shown && c.shown->done;
+
+    unsigned width = std::max(1, getmaxx(c.win) - GRID_GAP);
+    if (!c.shown)
+        return;
+    if (!c.shown->done)
+    {
+        mvwaddnstr(c.win, 0, indent, "Loading...", width);
+        return;
+    }
+    if (!c.shown->error.empty())
+    {
+        mvwaddnstr(c.win, 0, indent, "Not readable", width);
+        return;
+    }
+
+    // the marked entry stays in view
+    const auto &names = c.shown->entries;
+    const auto &widths = c.shown->widths;
+    size_t height = getmaxy(c.win);
+    auto it = std::lower_bound(names.begin(), names.end(), mark, entry_less);
+    size_t marked = !mark.empty() && it != names.end() && *it == mark ? it - names.begin() : names.size();
+    size_t top = marked < names.size() && marked >= height ? marked - height + 1 : 0;
+
+    for (size_t r = 0; r < height && top + r < names.size(); r++)
+    {
+        size_t i = top + r;
+        if (i == marked)
+            wattron(c.win, A_REVERSE);
+
+        if (widths[i] <= width)
+        {
+            mvwaddstr(c.win, r, indent, names[i].c_str());
+            if (i == marked)
+                whline(c.win, ' ', width - widths[i]);
+        }
+        else
+        {
+            mvwaddnstr(c.win, r, indent, names[i].c_str(), display_prefix(names[i], width - 1));
+            waddch(c.win, GRID_TRUNCATED);
+        }
+        wattroff(c.win, A_REVERSE);
+    }
+}
@@ -0,0 +1,141 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+
+/**
+ * owners.cpp
+ *
+ * One lookup per id runs at a time. Ids without a name are remembered as
+ * well, so a missing user doesn't cost a lookup per keystroke either.
+*/
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <chrono>
+#include <utility>
+
+#include <errno.h>
+#include <pwd.h>
+#include <grp.h>
+
+#include "owners.hpp"
+#include "aio.hpp"
+#include "pool.hpp"
+#include "stats.hpp"
+
+namespace
+{
+struct name
+{
+    std::string text;
+    bool known = false;
+    bool running = false;
+    long long expires = 0;
+};
+
+std::unordered_map<unsigned, name> users;
+std::unordered_map<unsigned, name> groups;
+bool arrived = false;
+
+long long now()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the _r functions report a buffer that is too small with ERANGE
+template <typename T, typename F>
+std::string lookup(F get, char *T::*field)
+{
+    cliex::stats::timer t{cliex::stats::CALL_NAME_LOOKUP};
+    std::vector<char> buf(1024);
+    T entry;
+    T *result = nullptr;
+    int err;
+    while ((err = get(&entry, buf.data(), buf.size(), &result)) == ERANGE)
+        buf.resize(buf.size() * 2);
+    return err == 0 && result ? result->*field : "";
+}
+
+std::string user_name(unsigned uid)
+{
+    return lookup<struct passwd>([uid](struct passwd *e, char *buf, size_t size, struct passwd **result)
+    {
+        return getpwuid_r(uid, e, buf, size, result);
+    }, &passwd::pw_name);
+}
+
+std::string group_name(unsigned gid)
+{
+    return lookup<struct group>([gid](struct group *e, char *buf, size_t size, struct group **result)
+    {
+        return getgrgid_r(gid, e, buf, size, result);
+    }, &group::gr_name);
+}
+
+cliex::aio::task<void> resolve(unsigned id, bool is_group)
+{
+    std::string text;
+    try
+    {
+        text = co_await cliex::aio::offload([id, is_group]
+        {
+            cliex::pool::io_slot io;
+            return is_group ? group_name(id) : user_name(id);
+        }, cliex::PRIORITY_VISIBLE);
+    }
+    catch (const std::exception&)
+    {
+    }
+
+    auto &n = (is_group ? groups : users)[id];
+    if (!n.known || n.text != text)
+        arrived = true;
+    n.text = std::move(text);
+    n.known = true;
+    n.running = false;
+    n.expires = now() + OWNERS_TTL;
+}
+
+std::string get(std::unordered_map<unsigned, name> &names, unsigned id, bool is_group)
+{
+    auto &n = names[id];
+    if (!n.running && (!n.known || now() >= n.expires))
+    {
+        n.running = true;
+        cliex::aio::spawn(resolve(id, is_group));
+    }
+    return n.text.empty() ? std::to_string(id) : n.text;
+}
+}
+
+std::string cliex::owners::user(unsigned uid)
+{
+    return get(users, uid, false);
+}
+
+std::string cliex::owners::group(unsigned gid)
+{
+    return get(groups, gid, true);
+}
+
+bool cliex::owners::changed()
+{
+    return std::exchange(arrived, false);
+}
@@ -0,0 +1,215 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * perf.cpp
+ *
+ * One counter group per thread, opened on the first scope of that thread.
+ * Counters the CPU or the hypervisor doesn't offer are left out of the group
+ * and reported as n/a.
+*/
+
+#include <sstream>
+#include <iomanip>
+
+#include <string>
+#include <map>
+
+#include <atomic>
+#include <mutex>
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.hpp"
+
+namespace
+{
+struct totals
+{
+    unsigned long long calls = 0;
+    unsigned long long values[cliex::perf::PERF_COUNT] = {};
+};
+
+struct group
+{
+    int fds[cliex::perf::PERF_COUNT] = {-1, -1, -1, -1};
+    int index[cliex::perf::PERF_COUNT] = {-1, -1, -1, -1};
+    int size = 0;
+    bool tried = false;
+
+    bool open();
+    bool read(unsigned long long (&)[cliex::perf::PERF_COUNT]);
+
+    ~group()
+    {
+        for (auto fd : fds)
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+    }
+};
+
+const unsigned long long configs[cliex::perf::PERF_COUNT] =
+{
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+const char *names[cliex::perf::PERF_COUNT] =
+{
+    "cycles", "instructions", "cache misses", "branch misses"
+};
+
+std::atomic<bool> is_enabled{false};
+std::mutex mtx;
+std::string reason = "not enabled";
+bool supported[cliex::perf::PERF_COUNT] = {};
+std::map<std::string, totals> ops;
+
+thread_local group counters;
+
+bool group::open()
+{
+    tried = true;
+
+    for (int c = 0; c < cliex::perf::PERF_COUNT; c++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[c];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        // cycles lead the group, without them there is nothing to measure
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, c ? fds[0] : -1, 0);
+        if (fd < 0)
+        {
+            if (c == 0)
+                return false;
+            continue;
+        }
+
+        fds[c] = fd;
+        index[c] = size++;
+    }
+    return size > 0;
+}
+
+bool group::read(unsigned long long (&v)[cliex::perf::PERF_COUNT])
+{
+    unsigned long long buf[1 + cliex::perf::PERF_COUNT];
+    if (::read(fds[0], buf, sizeof buf) < static_cast<ssize_t>((1 + size) * sizeof buf[0]))
+        return false;
+
+    for (int c = 0; c < cliex::perf::PERF_COUNT; c++)
+        v[c] = index[c] >= 0 ? buf[1 + index[c]] : 0;
+    return true;
+}
+}
+
+bool cliex::perf::enable()
+{
+    if (!counters.tried && !counters.open())
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        reason = std::string("unavailable: ") + strerror(errno);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (int c = 0; c < PERF_COUNT; c++)
+        supported[c] = counters.index[c] >= 0;
+    reason.clear();
+    is_enabled = true;
+    return true;
+}
+
+bool cliex::perf::enabled()
+{
+    return is_enabled;
+}
+
+cliex::perf::scope::scope(const char *name) : op(name), active(false)
+{
+    if (!is_enabled)
+        return;
+    if (!counters.tried)
+        counters.open();
+
+    active = counters.size && counters.read(start);
+}
+
+cliex::perf::scope::~scope()
+{
+    unsigned long long end[PERF_COUNT];
+    if (!active || !counters.read(end))
+        return;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto &t = ops[op];
+    t.calls++;
+    for (int c = 0; c < PERF_COUNT; c++)
+        t.values[c] += end[c] - start[c];
+}
+
+std::string cliex::perf::dump()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::ostringstream out;
+
+    out << "\nhardware counters";
+    if (!reason.empty())
+    {
+        out << ": " << reason << "\n";
+        return out.str();
+    }
+    out << " (per call):\n";
+
+    out << std::left << std::setw(18) << "operation" << std::right << std::setw(8) << "calls";
+    for (int c = 0; c < PERF_COUNT; c++)
+        out << std::setw(16) << names[c];
+    out << std::setw(8) << "IPC" << "\n";
+
+    for (const auto &o : ops)
+    {
+        const auto &t = o.second;
+        out << std::left << std::setw(18) << o.first << std::right << std::setw(8) << t.calls;
+        for (int c = 0; c < PERF_COUNT; c++)
+        {
+            if (supported[c])
+                out << std::setw(16) << t.values[c] / t.calls;
+            else
+                out << std::setw(16) << "n/a";
+        }
+
+        if (supported[PERF_CYCLES] && supported[PERF_INSTRUCTIONS] && t.values[PERF_CYCLES])
+            out << std::setw(8) << std::fixed << std::setprecision(2) << static_cast<double>(t.values[PERF_INSTRUCTIONS]) / t.values[PERF_CYCLES];
+        out << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,228 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * pool.cpp
+ *
+ * Work-stealing workers. A worker takes the newest task of its own deque
+ * (it's likely still in cache) and steals the oldest task of another one.
+*/
+
+#include <vector>
+#include <deque>
+
+#include <algorithm>
+
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include <sched.h>
+
+#include "pool.hpp"
+#include "profiler.hpp"
+
+namespace
+{
+struct task
+{
+    std::function<void()> run;
+    cliex::cancel_token token;
+};
+
+struct worker
+{
+    std::mutex mtx;
+    std::deque<task> queues[cliex::PRIORITY_COUNT];
+    std::thread thread;
+};
+
+std::vector<std::unique_ptr<worker>> workers;
+std::atomic<unsigned> next_worker{0};
+std::atomic<bool> stopping{false};
+
+// woken whenever there may be work, pending counts the queued tasks
+std::mutex idle_mtx;
+std::condition_variable idle;
+std::atomic<size_t> pending{0};
+
+std::mutex io_mtx;
+std::condition_variable io_free;
+unsigned io_used = 0;
+
+thread_local int self = -1;
+
+bool take(size_t w, cliex::priority p, bool own, task &t)
+{
+    auto &k = *workers[w];
+    std::lock_guard<std::mutex> lock(k.mtx);
+    auto &q = k.queues[p];
+    if (q.empty())
+        return false;
+
+    if (own)
+    {
+        t = std::move(q.back());
+        q.pop_back();
+    }
+    else
+    {
+        t = std::move(q.front());
+        q.pop_front();
+    }
+    pending--;
+    return true;
+}
+
+bool find_task(size_t w, task &t)
+{
+    for (int p = 0; p < cliex::PRIORITY_COUNT; p++)
+    {
+        auto prio = static_cast<cliex::priority>(p);
+        if (take(w, prio, true, t))
+            return true;
+
+        for (size_t i = 1; i < workers.size(); i++)
+        {
+            if (take((w + i) % workers.size(), prio, false, t))
+                return true;
+        }
+    }
+    return false;
+}
+
+void run_worker(size_t w)
+{
+    cliex::profiler::thread_guard sampled;
+    self = w;
+
+    task t;
+    while (true)
+    {
+        if (find_task(w, t))
+        {
+            if (!t.token.cancelled())
+                t.run();
+            t = task{};
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idle_mtx);
+        idle.wait(lock, []
+        {
+            return stopping || pending > 0;
+        });
+        if (stopping)
+            return;
+    }
+}
+
+unsigned usable_cpus()
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof set, &set) == 0)
+        return CPU_COUNT(&set);
+    return std::thread::hardware_concurrency();
+}
+}
+
+cliex::cancel_token cliex::cancel_token::create()
+{
+    cancel_token t;
+    t.flag = std::make_shared<std::atomic<bool>>(false);
+    return t;
+}
+
+void cliex::cancel_token::cancel() const
+{
+    if (flag)
+        *flag = true;
+}
+
+bool cliex::cancel_token::cancelled() const
+{
+    return flag && *flag;
+}
+
+void cliex::pool::start()
+{
+    if (!workers.empty())
+        return;
+
+    // at least two, so a blocking task never starves the others
+    unsigned count = std::max(2u, std::min(usable_cpus(), static_cast<unsigned>(POOL_MAX_WORKERS)));
+    for (unsigned i = 0; i < count; i++)
+        workers.emplace_back(new worker);
+    for (unsigned i = 0; i < count; i++)
+        workers[i]->thread = std::thread(run_worker, i);
+}
+
+void cliex::pool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(idle_mtx);
+        stopping = true;
+    }
+    idle.notify_all();
+
+    for (auto &w : workers)
+        w->thread.join();
+    workers.clear();
+}
+
+unsigned cliex::pool::size()
+{
+    return workers.size();
+}
+
+void cliex::pool::submit(std::function<void()> f, priority p, cancel_token token)
+{
+    start();
+
+    size_t w = self >= 0 ? self : next_worker++ % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(workers[w]->mtx);
+        workers[w]->queues[p].push_back({std::move(f), std::move(token)});
+        pending++;
+    }
+
+    std::lock_guard<std::mutex> lock(idle_mtx);
+    idle.notify_one();
+}
+
+cliex::pool::io_slot::io_slot()
+{
+    std::unique_lock<std::mutex> lock(io_mtx);
+    io_free.wait(lock, []
+    {
+        return io_used < POOL_MAX_BLOCKING_IO;
+    });
+    io_used++;
+}
+
+cliex::pool::io_slot::~io_slot()
+{
+    {
+        std::lock_guard<std::mutex> lock(io_mtx);
+        io_used--;
+    }
+    io_free.notify_one();
+}
@@ -0,0 +1,259 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * profiler.cpp
+ *
+ * SIGPROF sampling with frame-pointer unwinding. The signal handler only
+ * touches preallocated memory and atomics.
+*/
+
+#include <fstream>
+
+#include <string>
+
+#include <vector>
+#include <unordered_map>
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+
+#include "profiler.hpp"
+
+namespace
+{
+struct sample
+{
+    int depth;
+    uintptr_t pcs[PROFILER_MAX_DEPTH];
+};
+
+std::unique_ptr<sample[]> samples;
+std::atomic<size_t> next_sample{0};
+std::atomic<size_t> dropped{0};
+std::atomic<bool> running{false};
+std::string output;
+
+std::mutex mtx;
+std::unordered_map<pid_t, timer_t> timers;
+
+thread_local uintptr_t stack_lo = 0;
+thread_local uintptr_t stack_hi = 0;
+
+void get_registers(void *context, uintptr_t &pc, uintptr_t &fp)
+{
+    auto uc = static_cast<ucontext_t *>(context);
+#if defined(__x86_64__)
+    pc = uc->uc_mcontext.gregs[REG_RIP];
+    fp = uc->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+    pc = uc->uc_mcontext.pc;
+    fp = uc->uc_mcontext.regs[29];
+#else
+    (void) uc;
+    pc = fp = 0;
+#endif
+}
+
+void handler(int, siginfo_t *, void *context)
+{
+    if (!running || !stack_hi)
+        return;
+
+    size_t i = next_sample.fetch_add(1, std::memory_order_relaxed);
+    if (i >= PROFILER_MAX_SAMPLES)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto &s = samples[i];
+    uintptr_t pc, fp;
+    get_registers(context, pc, fp);
+
+    s.depth = 0;
+    s.pcs[s.depth++] = pc;
+
+    // every frame starts with the caller's frame pointer, followed by the
+    // return address; stop as soon as the chain leaves this thread's stack
+    while (s.depth < PROFILER_MAX_DEPTH && fp >= stack_lo && fp + 2 * sizeof(uintptr_t) <= stack_hi && !(fp & (sizeof(uintptr_t) - 1)))
+    {
+        auto frame = reinterpret_cast<uintptr_t *>(fp);
+        uintptr_t ret = frame[1];
+        if (!ret)
+            break;
+
+        s.pcs[s.depth++] = ret;
+        if (frame[0] <= fp)
+            break;
+        fp = frame[0];
+    }
+}
+
+std::string symbolize(uintptr_t pc)
+{
+    Dl_info info;
+    if (!dladdr(reinterpret_cast<void *>(pc), &info))
+        return "[unknown]";
+
+    if (info.dli_sname)
+    {
+        int status;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 ? demangled : info.dli_sname;
+        free(demangled);
+
+        // folded stacks use ';' and ' ' as separators
+        for (auto &c : name)
+        {
+            if (c == ';' || c == ' ')
+                c = '_';
+        }
+        return name;
+    }
+
+    std::string module = info.dli_fname ? info.dli_fname : "?";
+    module = module.substr(module.rfind('/') + 1);
+
+    char offset[32];
+    snprintf(offset, sizeof offset, "+0x%lx", static_cast<unsigned long>(pc - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+    return "[" + module + offset + "]";
+}
+}
+
+bool cliex::profiler::start(const std::string &file)
+{
+    samples.reset(new sample[PROFILER_MAX_SAMPLES]);
+    output = file;
+
+    struct sigaction sa;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_sigaction = handler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    if (sigaction(SIGPROF, &sa, nullptr))
+        return false;
+
+    running = true;
+    register_thread();
+    return true;
+}
+
+void cliex::profiler::register_thread()
+{
+    if (!running)
+        return;
+
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr))
+        return;
+
+    void *addr;
+    size_t size;
+    pthread_attr_getstack(&attr, &addr, &size);
+    pthread_attr_destroy(&attr);
+
+    stack_lo = reinterpret_cast<uintptr_t>(addr);
+    stack_hi = stack_lo + size;
+
+    pid_t tid = syscall(SYS_gettid);
+
+    struct sigevent ev = {};
+    ev.sigev_notify = SIGEV_THREAD_ID;
+    ev.sigev_signo = SIGPROF;
+    ev._sigev_un._tid = tid;
+
+    timer_t timer;
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &ev, &timer))
+        return;
+
+    struct itimerspec interval = {};
+    interval.it_interval.tv_nsec = 1000000000 / PROFILER_HZ;
+    interval.it_value = interval.it_interval;
+    timer_settime(timer, 0, &interval, nullptr);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    timers[tid] = timer;
+}
+
+void cliex::profiler::unregister_thread()
+{
+    pid_t tid = syscall(SYS_gettid);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = timers.find(tid);
+    if (it == timers.end())
+        return;
+
+    timer_delete(it->second);
+    timers.erase(it);
+}
+
+bool cliex::profiler::stop()
+{
+    if (!running)
+        return false;
+
+    running = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto &t : timers)
+            timer_delete(t.second);
+        timers.clear();
+    }
+
+    std::unordered_map<uintptr_t, std::string> names;
+    std::unordered_map<std::string, size_t> folded;
+
+    size_t count = std::min<size_t>(next_sample, PROFILER_MAX_SAMPLES);
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto &s = samples[i];
+        std::string stack;
+        for (int d = s.depth - 1; d >= 0; d--)
+        {
+            // return addresses point behind the call, look up the call itself
+            uintptr_t pc = d ? s.pcs[d] - 1 : s.pcs[d];
+            auto it = names.find(pc);
+            if (it == names.end())
+                it = names.emplace(pc, symbolize(pc)).first;
+
+            if (!stack.empty())
+                stack += ';';
+            stack += it->second;
+        }
+        folded[stack]++;
+    }
+
+    std::ofstream out{output};
+    for (const auto &f : folded)
+        out << f.first << " " << f.second << "\n";
+    if (dropped)
+        out << "[dropped] " << dropped << "\n";
+
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,455 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+
+/**
+ * query.cpp
+ *
+ * A recursive descent parser straight into the program; there is no syntax
+ * tree. The register starts out true, so an empty expression matches
+ * everything.
+*/
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+#include <system_error>
+#include <chrono>
+
+#include <experimental/filesystem>
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "query.hpp"
+#include "cliex.hpp"
+#include "filter.hpp"
+#include "stats.hpp"
+#include "vfs.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+bool is_operator(char c)
+{
+    return strchr("<>=!~&|", c);
+}
+}
+
+// what is known about one entry, the metadata is only read when asked for
+struct cliex::query::entry
+{
+    const listing &l;
+    const std::string &name;
+    int &dirfd;
+
+    bool loaded = false;
+    unsigned kind = 0;
+    unsigned long long size = 0;
+    long long mtime = 0;
+
+    bool is_dir() const
+    {
+        return name.back() == '/';
+    }
+
+    std::string_view bare_name() const
+    {
+        return is_dir() ? std::string_view(name).substr(0, name.size() - 1) : std::string_view(name);
+    }
+
+    unsigned get_kind()
+    {
+        if (is_dir())
+            return FILTER_DIR;
+        load();
+        return kind;
+    }
+
+    void load()
+    {
+        if (loaded)
+            return;
+        loaded = true;
+
+        if (get_vfs().native())
+            load_native();
+        else
+            load_vfs();
+    }
+
+    // like the listing, links to directories are directories
+    void load_native()
+    {
+        namespace stats = cliex::stats;
+
+        if (dirfd < 0)
+        {
+            stats::timer t{stats::CALL_DIR_OPEN};
+            dirfd = open(l.dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+        if (dirfd < 0)
+            throw fs::filesystem_error("cannot open directory", l.dir, std::error_code(errno, std::generic_category()));
+
+        struct stat st;
+        int res;
+        {
+            stats::timer t{stats::CALL_SYMLINK_STATUS};
+            res = fstatat(dirfd, name.c_str(), &st, is_dir() ? 0 : AT_SYMLINK_NOFOLLOW);
+        }
+        if (res)
+            return;
+
+        kind = S_ISDIR(st.st_mode) ? FILTER_DIR : S_ISREG(st.st_mode) ? FILTER_FILE : S_ISLNK(st.st_mode) ? FILTER_LINK : FILTER_OTHER;
+        if (S_ISLNK(st.st_mode))
+        {
+            stats::timer t{stats::CALL_STATUS};
+            if (fstatat(dirfd, name.c_str(), &st, 0))
+                return;
+        }
+        size = S_ISREG(st.st_mode) ? st.st_size : 0;
+        mtime = st.st_mtim.tv_sec;
+    }
+
+    void load_vfs()
+    {
+        auto &vfs = get_vfs();
+        auto p = l.dir / std::string(bare_name());
+        try
+        {
+            auto link = vfs.symlink_status(p);
+            auto status = fs::is_symlink(link) ? vfs.status(p) : link;
+            kind = is_dir() ? FILTER_DIR : fs::is_regular_file(link) ? FILTER_FILE : fs::is_symlink(link) ? FILTER_LINK : FILTER_OTHER;
+            size = fs::is_regular_file(status) ? vfs.file_size(p) : 0;
+            mtime = std::chrono::duration_cast<std::chrono::seconds>(vfs.last_write_time(p).time_since_epoch()).count();
+        }
+        catch (const fs::filesystem_error&)
+        {
+        }
+    }
+};
+
+class cliex::query::parser
+{
+public:
+    parser(const std::string &s, query &q) : s(s), q(q)
+    {
+        next();
+    }
+
+    void parse()
+    {
+        if (kind == TOKEN_END)
+            return;
+        expression();
+        if (kind != TOKEN_END)
+            fail("unexpected '" + text + "'");
+    }
+
+private:
+    enum token_kind
+    {
+        TOKEN_END,
+        TOKEN_WORD,
+        TOKEN_STRING,
+        TOKEN_OPERATOR,
+        TOKEN_OPEN,
+        TOKEN_CLOSE
+    };
+
+    const std::string &s;
+    query &q;
+    size_t pos = 0;
+    token_kind kind;
+    std::string text;
+
+    [[noreturn]] void fail(const std::string &what)
+    {
+        throw std::invalid_argument(what);
+    }
+
+    void next()
+    {
+        while (pos < s.size() && isspace(static_cast<unsigned char>(s[pos])))
+            pos++;
+        text.clear();
+        if (pos == s.size())
+        {
+            kind = TOKEN_END;
+            return;
+        }
+
+        char c = s[pos];
+        if (c == '(' || c == ')')
+        {
+            kind = c == '(' ? TOKEN_OPEN : TOKEN_CLOSE;
+            text = c;
+            pos++;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            // a backslash only quotes the quote, globs keep theirs
+            kind = TOKEN_STRING;
+            for (pos++; pos < s.size() && s[pos] != c; pos++)
+            {
+                if (s[pos] == '\\' && pos + 1 < s.size() && s[pos + 1] == c)
+                    pos++;
+                text += s[pos];
+            }
+            if (pos == s.size())
+                fail("missing " + std::string(1, c));
+            pos++;
+        }
+        else if (is_operator(c))
+        {
+            kind = TOKEN_OPERATOR;
+            while (pos < s.size() && is_operator(s[pos]))
+                text += s[pos++];
+        }
+        else
+        {
+            kind = TOKEN_WORD;
+            while (pos < s.size() && !isspace(static_cast<unsigned char>(s[pos])) && !strchr("()\"'", s[pos]) && !is_operator(s[pos]))
+                text += s[pos++];
+        }
+    }
+
+    bool keyword(const char *word, const char *symbol)
+    {
+        return (kind == TOKEN_WORD && text == word) || (kind == TOKEN_OPERATOR && text == symbol);
+    }
+
+    size_t emit(opcode code, compare cmp = CMP_EQ, long long value = 0)
+    {
+        q.code.push_back({code, cmp, value});
+        return q.code.size() - 1;
+    }
+
+    void expression()
+    {
+        conjunction();
+        while (keyword("or", "||"))
+        {
+            next();
+            size_t jump = emit(OP_JUMP_TRUE);
+            conjunction();
+            q.code[jump].value = q.code.size();
+        }
+    }
+
+    void conjunction()
+    {
+        unary();
+        while (keyword("and", "&&"))
+        {
+            next();
+            size_t jump = emit(OP_JUMP_FALSE);
+            unary();
+            q.code[jump].value = q.code.size();
+        }
+    }
+
+    void unary()
+    {
+        if (keyword("not", "!"))
+        {
+            next();
+            unary();
+            emit(OP_NOT);
+        }
+        else if (kind == TOKEN_OPEN)
+        {
+            next();
+            expression();
+            if (kind != TOKEN_CLOSE)
+                fail("missing )");
+            next();
+        }
+        else
+        {
+            test();
+        }
+    }
+
+    void test()
+    {
+        if (kind != TOKEN_WORD)
+            fail(kind == TOKEN_END ? "incomplete expression" : "expected a field, not '" + text + "'");
+        std::string field = text;
+        if (field != "name" && field != "type" && field != "size" && field != "mtime")
+            fail("unknown field " + field + ", use name, type, size or mtime");
+
+        next();
+        if (kind != TOKEN_OPERATOR)
+            fail("expected a comparison after " + field);
+        std::string op = text;
+
+        next();
+        if (kind != TOKEN_WORD && kind != TOKEN_STRING)
+            fail("expected a value after " + field + " " + op);
+        std::string value = text;
+        next();
+
+        if (field == "name")
+        {
+            if (op == "~" || op == "!~")
+            {
+                q.globs.emplace_back(value);
+                emit(OP_NAME_GLOB, op == "~" ? CMP_EQ : CMP_NE, q.globs.size() - 1);
+            }
+            else if (op == "=" || op == "==" || op == "!=")
+            {
+                q.names.push_back(value);
+                emit(OP_NAME_EQUAL, op == "!=" ? CMP_NE : CMP_EQ, q.names.size() - 1);
+            }
+            else
+            {
+                fail("name can't be compared with " + op);
+            }
+            return;
+        }
+
+        compare cmp = op == "=" || op == "==" ? CMP_EQ
+                    : op == "!=" ? CMP_NE
+                    : op == "<" ? CMP_LT
+                    : op == "<=" ? CMP_LE
+                    : op == ">" ? CMP_GT
+                    : op == ">=" ? CMP_GE
+                    : static_cast<compare>(-1);
+        if (cmp == static_cast<compare>(-1))
+            fail("unknown comparison " + op);
+
+        if (field == "type")
+        {
+            if (cmp != CMP_EQ && cmp != CMP_NE)
+                fail("type can't be compared with " + op);
+
+            long long mask = value == "file" ? FILTER_FILE
+                           : value == "dir" ? FILTER_DIR
+                           : value == "symlink" || value == "link" ? FILTER_LINK
+                           : value == "other" ? FILTER_OTHER
+                           : 0;
+            if (!mask)
+                fail("unknown type " + value + ", use file, dir, symlink or other");
+            emit(OP_TYPE, cmp, mask);
+        }
+        else if (field == "size")
+        {
+            emit(OP_SIZE, cmp, parse_size(value));
+        }
+        else
+        {
+            emit(OP_AGE, cmp, parse_age(value));
+        }
+    }
+};
+
+bool cliex::query::holds(long long a, compare cmp, long long b)
+{
+    switch (cmp)
+    {
+    case CMP_EQ:
+        return a == b;
+    case CMP_NE:
+        return a != b;
+    case CMP_LT:
+        return a < b;
+    case CMP_LE:
+        return a <= b;
+    case CMP_GT:
+        return a > b;
+    default:
+        return a >= b;
+    }
+}
+
+cliex::query::query(const std::string &s) : now(time(nullptr))
+{
+    parser{s, *this}.parse();
+}
+
+bool cliex::query::matches(entry &e) const
+{
+    bool r = true;
+    for (size_t pc = 0; pc < code.size(); pc++)
+    {
+        const auto &i = code[pc];
+        switch (i.code)
+        {
+        case OP_NAME_GLOB:
+            r = globs[i.value].match(e.bare_name()) == (i.cmp == CMP_EQ);
+            break;
+        case OP_NAME_EQUAL:
+            r = (e.bare_name() == names[i.value]) == (i.cmp == CMP_EQ);
+            break;
+        case OP_TYPE:
+            r = ((e.get_kind() & i.value) != 0) == (i.cmp == CMP_EQ);
+            break;
+        case OP_SIZE:
+            e.load();
+            r = holds(e.size, i.cmp, i.value);
+            break;
+        case OP_AGE:
+            e.load();
+            r = holds(now - e.mtime, i.cmp, i.value);
+            break;
+        case OP_NOT:
+            r = !r;
+            break;
+        case OP_JUMP_FALSE:
+            if (!r)
+                pc = i.value - 1;
+            break;
+        case OP_JUMP_TRUE:
+            if (r)
+                pc = i.value - 1;
+            break;
+        }
+    }
+    return r;
+}
+
+void cliex::query::select(const listing &l, size_t begin, size_t end, std::vector<size_t> &out) const
+{
+    // opened by the first entry that needs a stat
+    int dirfd = -1;
+    try
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const auto &name = l.entries[i];
+            entry e{l, name, dirfd};
+            if (name == ".." || matches(e))
+                out.push_back(i);
+        }
+    }
+    catch (...)
+    {
+        if (dirfd >= 0)
+            close(dirfd);
+        throw;
+    }
+    if (dirfd >= 0)
+        close(dirfd);
+}
@@ -0,0 +1,303 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * script.cpp
+ *
+ * Key scripts and timing for the headless mode.
+ *
+ * A script has one key per line, optionally followed by a repeat count:
+ *
+ *     # walk down the listing and enter the selected directory
+ *     down 20
+ *     enter
+ *     q
+ *
+ * Known names are up, down, left, right, npage, ppage, enter, backspace, tab,
+ * btab and escape. Any other single character is sent as it is. "resize 100
+ * 30" resizes the terminal to 100 columns and 30 lines, "text size > 1m"
+ * types everything after the first space.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+
+#include <string>
+
+#include <vector>
+#include <map>
+
+#include <algorithm>
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <wchar.h>
+#include <sys/stat.h>
+
+#include <ncurses.h>
+
+#include "script.hpp"
+#include "cliex.hpp"
+#include "frame.hpp"
+
+namespace
+{
+struct timing
+{
+    int key;
+    long long ns;
+};
+
+std::vector<int> keys;
+size_t next = 0;
+
+std::vector<timing> timings;
+std::chrono::steady_clock::time_point key_start;
+bool key_pending = false;
+
+FILE *output = nullptr;
+
+const std::map<std::string, int> key_names
+{
+    {"up", KEY_UP},
+    {"down", KEY_DOWN},
+    {"left", KEY_LEFT},
+    {"right", KEY_RIGHT},
+    {"npage", KEY_NPAGE},
+    {"ppage", KEY_PPAGE},
+    {"enter", 0xA},
+    {"backspace", KEY_BACKSPACE},
+    {"tab", '\t'},
+    {"btab", KEY_BTAB},
+    {"escape", 27},
+    {"resize", KEY_RESIZE},
+};
+
+std::vector<std::pair<int, int>> sizes;
+size_t next_size = 0;
+int lines = 0, columns = 0;
+
+std::string key_label(int key)
+{
+    for (const auto &k : key_names)
+    {
+        if (k.second == key)
+            return k.first;
+    }
+    return std::string(1, static_cast<char>(key));
+}
+}
+
+bool cliex::script::load(const std::string &file)
+{
+    std::ifstream in{file};
+    if (!in)
+        return false;
+
+    std::string line, name;
+    while (std::getline(in, line))
+    {
+        line = trim(line);
+        if (!line.length() || line[0] == '#')
+            continue;
+
+        std::istringstream words{line};
+        int count = 1;
+        words >> name;
+        if (name == "resize")
+        {
+            int cols = 0, rows = 0;
+            words >> cols >> rows;
+            if (cols <= 0 || rows <= 0)
+                return false;
+
+            sizes.emplace_back(rows, cols);
+            keys.push_back(KEY_RESIZE);
+            continue;
+        }
+        if (name == "text")
+        {
+            auto start = line.find(' ');
+            for (size_t i = start + 1; start != std::string::npos && i < line.size(); i++)
+                keys.push_back(static_cast<unsigned char>(line[i]));
+            continue;
+        }
+        words >> count;
+
+        int key;
+        auto it = key_names.find(name);
+        if (it != key_names.end())
+            key = it->second;
+        else if (name.length() == 1)
+            key = name[0];
+        else
+            return false;
+
+        keys.insert(keys.end(), std::max(count, 0), key);
+    }
+    return true;
+}
+
+SCREEN *cliex::script::open_screen()
+{
+    const char *term = getenv("TERM");
+    FILE *in = fopen("/dev/null", "r");
+
+    // the terminal output is kept only to count it
+    output = tmpfile();
+    if (!output)
+        output = fopen("/dev/null", "w");
+
+    SCREEN *screen = newterm(term && *term ? term : SCRIPT_TERM, output, in);
+    if (!screen)
+        screen = newterm(SCRIPT_TERM, output, in);
+    return screen;
+}
+
+bool cliex::script::size(int &rows, int &cols)
+{
+    if (!lines)
+        return false;
+
+    rows = lines;
+    cols = columns;
+    return true;
+}
+
+int cliex::script::output_fd()
+{
+    return output ? fileno(output) : -1;
+}
+
+bool cliex::script::next_key(int &key)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (key_pending)
+        timings.back().ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - key_start).count();
+
+    key_pending = next < keys.size();
+    if (!key_pending)
+        return false;
+
+    key = keys[next++];
+    if (key == KEY_RESIZE)
+    {
+        lines = sizes[next_size].first;
+        columns = sizes[next_size++].second;
+    }
+
+    timings.push_back({key, 0});
+    key_start = now;
+    return true;
+}
+
+std::string cliex::script::screen_text()
+{
+    std::string text;
+    for (int y = 0; y < LINES; y++)
+    {
+        std::string row;
+        for (int x = 0; x < COLS; x++)
+        {
+            cchar_t cell;
+            wchar_t wch[CCHARW_MAX + 1] = {};
+            attr_t attrs;
+            short pair;
+            mvwin_wch(curscr, y, x, &cell);
+            getcchar(&cell, wch, &attrs, &pair, nullptr);
+
+            if (attrs & A_ALTCHARSET)
+            {
+                row += (wch[0] == 'q') ? '-' : (wch[0] == 'x') ? '|' : '+';
+                continue;
+            }
+
+            char mb[MB_LEN_MAX];
+            std::mbstate_t state{};
+            for (int i = 0; wch[i]; i++)
+            {
+                size_t n = wcrtomb(mb, wch[i], &state);
+                if (n != static_cast<size_t>(-1))
+                    row.append(mb, n);
+            }
+
+            // a wide character fills the next cell as well
+            int w = wcwidth(wch[0]);
+            if (w > 1)
+                x += w - 1;
+        }
+        text += trim(row, " ") + "\n";
+    }
+    return text;
+}
+
+void cliex::script::report(std::ostream &out)
+{
+    // a 'q' that ended the loop is never timed
+    std::vector<timing> done(timings.begin(), timings.end() - (key_pending ? 1 : 0));
+    if (done.empty())
+    {
+        out << "no keys\n";
+        return;
+    }
+
+    std::vector<long long> ns;
+    long long total = 0;
+    for (const auto &t : done)
+    {
+        ns.push_back(t.ns);
+        total += t.ns;
+    }
+    std::sort(ns.begin(), ns.end());
+
+    auto pct = [&ns](double p)
+    {
+        return ns[std::min(ns.size() - 1, static_cast<size_t>(p * ns.size()))] / 1e3;
+    };
+
+    out << std::fixed << std::setprecision(1)
+        << "keys: " << done.size()
+        << "  total: " << total / 1e6 << " ms"
+        << "  mean: " << total / 1e3 / done.size() << " us"
+        << "  p50: " << pct(0.5) << " us"
+        << "  p99: " << pct(0.99) << " us"
+        << "  max: " << ns.back() / 1e3 << " us\n";
+
+    std::map<std::string, std::pair<size_t, long long>> per_key;
+    for (const auto &t : done)
+    {
+        auto &k = per_key[key_label(t.key)];
+        k.first++;
+        k.second += t.ns;
+    }
+    for (const auto &k : per_key)
+    {
+        out << "  " << std::left << std::setw(10) << k.first << std::right
+            << std::setw(8) << k.second.first << " x "
+            << std::setw(10) << k.second.second / 1e3 / k.second.first << " us\n";
+    }
+
+    struct stat st;
+    if (output && fstat(fileno(output), &st) == 0)
+        out << "output: " << st.st_size << " bytes in " << frame::frames() << " frames\n";
+}
@@ -0,0 +1,373 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * shm.cpp
+ *
+ * The segment starts with a header, the reader table and the index, the
+ * rest is a ring of records that only ever grows at its tail. Offsets into
+ * the ring are logical, they keep growing while the ring wraps around.
+ *
+ * Index slots are seqlocks: a writer makes the sequence odd while it changes
+ * a slot, a reader retries if the sequence was odd or changed meanwhile.
+ *
+ * Space is reclaimed by epochs: a reader announces the offset of the record
+ * it copies before it checks that the record is still intact, a writer
+ * reserves space before it looks at the announced offsets and waits for the
+ * readers of the records it is about to overwrite. One of the two always
+ * sees the other.
+*/
+
+#include <string>
+#include <vector>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm.hpp"
+
+#define SHM_MAGIC 0x636c697800000001ULL
+#define SHM_IDLE UINT64_MAX
+
+namespace
+{
+struct slot
+{
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> dev;
+    std::atomic<uint64_t> ino;
+    std::atomic<int64_t> mtime_ns;
+    std::atomic<uint64_t> offset;
+    // 0 while the slot is unused
+    std::atomic<uint64_t> length;
+};
+
+struct reader
+{
+    // 0 while the entry is free
+    std::atomic<int32_t> pid;
+    // offset of the record being read, SHM_IDLE if none
+    std::atomic<uint64_t> epoch;
+};
+
+struct header
+{
+    std::atomic<uint64_t> magic;
+    std::atomic<uint64_t> tail;
+    reader readers[SHM_MAX_READERS];
+    slot slots[SHM_INDEX_SLOTS];
+};
+
+// followed by count names, each ending with a NUL
+struct record
+{
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_ns;
+    uint32_t count;
+    uint32_t length;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<int32_t>::is_always_lock_free, "the segment needs atomics that work across processes");
+
+#define SHM_RING_START ((sizeof(header) + 63) & ~size_t(63))
+#define SHM_RING_SIZE (SHM_SEGMENT_SIZE - SHM_RING_START)
+
+header *seg = nullptr;
+char *ring = nullptr;
+
+size_t hash(const cliex::shm::key &k)
+{
+    uint64_t h = (k.dev * 0x9e3779b97f4a7c15ULL) ^ k.ino;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    return h ^ (h >> 32);
+}
+
+bool read_slot(slot &s, const cliex::shm::key &k, uint64_t &offset, uint64_t &length)
+{
+    for (int tries = 0; tries < 3; tries++)
+    {
+        auto before = s.seq.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        bool same = s.dev.load(std::memory_order_relaxed) == k.dev
+                    && s.ino.load(std::memory_order_relaxed) == k.ino
+                    && s.mtime_ns.load(std::memory_order_relaxed) == k.mtime_ns;
+        offset = s.offset.load(std::memory_order_relaxed);
+        length = s.length.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) == before)
+            return same && length;
+    }
+    return false;
+}
+
+reader *claim_reader()
+{
+    int32_t self = getpid();
+    for (auto &r : seg->readers)
+    {
+        int32_t free = 0;
+        if (r.pid.compare_exchange_strong(free, self))
+            return &r;
+    }
+    return nullptr;
+}
+
+void release_reader(reader &r)
+{
+    r.epoch.store(SHM_IDLE, std::memory_order_release);
+    r.pid.store(0, std::memory_order_release);
+}
+
+bool copy_record(const cliex::shm::key &k, uint64_t offset, uint64_t length, std::vector<std::string> &v)
+{
+    const char *start = ring + offset % SHM_RING_SIZE;
+    if (offset % SHM_RING_SIZE + length > SHM_RING_SIZE || length < sizeof(record))
+        return false;
+
+    record r;
+    memcpy(&r, start, sizeof r);
+    if (r.dev != k.dev || r.ino != k.ino || r.mtime_ns != k.mtime_ns || sizeof r + r.length > length)
+        return false;
+
+    std::vector<std::string> names;
+    names.reserve(r.count);
+    const char *p = start + sizeof r, *end = p + r.length;
+    while (p < end)
+    {
+        auto nul = static_cast<const char *>(memchr(p, '\0', end - p));
+        if (!nul)
+            return false;
+        names.emplace_back(p, nul);
+        p = nul + 1;
+    }
+    if (names.size() != r.count)
+        return false;
+
+    v.swap(names);
+    return true;
+}
+
+// whether the readers of records before limit are gone
+bool wait_for_readers(uint64_t limit)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SHM_WAIT_MS);
+    while (true)
+    {
+        bool busy = false;
+        for (auto &r : seg->readers)
+        {
+            auto pid = r.pid.load();
+            auto epoch = r.epoch.load();
+            if (!pid || epoch >= limit)
+                continue;
+
+            // a reader that died while reading would block the space forever
+            if (kill(pid, 0) && errno == ESRCH)
+            {
+                r.epoch.store(SHM_IDLE);
+                r.pid.compare_exchange_strong(pid, 0);
+                continue;
+            }
+            busy = true;
+        }
+
+        if (!busy)
+            return true;
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::yield();
+    }
+}
+
+slot &choose_slot(const cliex::shm::key &k)
+{
+    size_t h = hash(k);
+    slot *oldest = nullptr;
+    for (int i = 0; i < SHM_PROBES; i++)
+    {
+        auto &s = seg->slots[(h + i) % SHM_INDEX_SLOTS];
+        bool same = s.dev.load(std::memory_order_relaxed) == k.dev && s.ino.load(std::memory_order_relaxed) == k.ino;
+        if (same || !s.length.load(std::memory_order_relaxed))
+            return s;
+        if (!oldest || s.offset.load(std::memory_order_relaxed) < oldest->offset.load(std::memory_order_relaxed))
+            oldest = &s;
+    }
+    return *oldest;
+}
+
+long long now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+}
+
+bool cliex::shm::open()
+{
+    if (seg)
+        return true;
+
+    auto name = "/cliex-" + std::to_string(getuid());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    bool created = fd >= 0;
+    if (!created && errno == EEXIST)
+        fd = shm_open(name.c_str(), O_RDWR | O_NOFOLLOW | O_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+
+    // a segment anyone else could write to could hand out made-up listings
+    struct stat st;
+    bool usable = !fstat(fd, &st) && st.st_uid == getuid() && !(st.st_mode & 077);
+    if (usable && created)
+        usable = !ftruncate(fd, SHM_SEGMENT_SIZE);
+    for (int tries = 0; usable && st.st_size < SHM_SEGMENT_SIZE && tries < 100; tries++)
+    {
+        // the process that created it hasn't sized it yet
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        usable = !fstat(fd, &st);
+    }
+    if (!usable || st.st_size < SHM_SEGMENT_SIZE)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *p = mmap(nullptr, SHM_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    auto h = static_cast<header *>(p);
+    if (created)
+    {
+        // the file starts out zeroed, only the idle epochs need setting
+        for (auto &r : h->readers)
+            r.epoch.store(SHM_IDLE, std::memory_order_relaxed);
+        h->magic.store(SHM_MAGIC, std::memory_order_release);
+    }
+    for (int tries = 0; h->magic.load(std::memory_order_acquire) != SHM_MAGIC && tries < 100; tries++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // a segment of another version of cliex stays alone
+    if (h->magic.load(std::memory_order_acquire) != SHM_MAGIC)
+    {
+        munmap(p, SHM_SEGMENT_SIZE);
+        return false;
+    }
+
+    seg = h;
+    ring = static_cast<char *>(p) + SHM_RING_START;
+    return true;
+}
+
+bool cliex::shm::enabled()
+{
+    return seg;
+}
+
+bool cliex::shm::find(const key &k, std::vector<std::string> &v)
+{
+    if (!seg || !k.ino)
+        return false;
+
+    size_t h = hash(k);
+    for (int i = 0; i < SHM_PROBES; i++)
+    {
+        uint64_t offset, length;
+        if (!read_slot(seg->slots[(h + i) % SHM_INDEX_SLOTS], k, offset, length))
+            continue;
+
+        auto r = claim_reader();
+        if (!r)
+            return false;
+
+        r->epoch.store(offset);
+        auto tail = seg->tail.load();
+        bool found = offset + length <= tail && tail <= offset + SHM_RING_SIZE && copy_record(k, offset, length, v);
+        release_reader(*r);
+        return found;
+    }
+    return false;
+}
+
+void cliex::shm::publish(const key &k, const std::vector<std::string> &v)
+{
+    if (!seg || !k.ino || now_ns() - k.mtime_ns < SHM_RACY_NS)
+        return;
+
+    uint64_t length = sizeof(record);
+    for (const auto &name : v)
+        length += name.size() + 1;
+    uint64_t size = (length + 7) & ~uint64_t(7);
+    if (size > SHM_RING_SIZE / 2)
+        return;
+
+    // a record never wraps around the end of the ring
+    uint64_t start;
+    auto tail = seg->tail.load();
+    do
+    {
+        start = tail;
+        if (start % SHM_RING_SIZE + size > SHM_RING_SIZE)
+            start += SHM_RING_SIZE - start % SHM_RING_SIZE;
+    }
+    while (!seg->tail.compare_exchange_weak(tail, start + size));
+
+    // if readers don't let go, the space stays unused
+    if (start + size > SHM_RING_SIZE && !wait_for_readers(start + size - SHM_RING_SIZE))
+        return;
+
+    record r = {k.dev, k.ino, k.mtime_ns, static_cast<uint32_t>(v.size()), static_cast<uint32_t>(length - sizeof(record))};
+    auto p = ring + start % SHM_RING_SIZE;
+    memcpy(p, &r, sizeof r);
+    p += sizeof r;
+    for (const auto &name : v)
+    {
+        memcpy(p, name.c_str(), name.size() + 1);
+        p += name.size() + 1;
+    }
+
+    auto &s = choose_slot(k);
+    auto seq = s.seq.load(std::memory_order_relaxed);
+    if ((seq & 1) || !s.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acq_rel))
+        return;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s.dev.store(k.dev, std::memory_order_relaxed);
+    s.ino.store(k.ino, std::memory_order_relaxed);
+    s.mtime_ns.store(k.mtime_ns, std::memory_order_relaxed);
+    s.offset.store(start, std::memory_order_relaxed);
+    s.length.store(length, std::memory_order_relaxed);
+    s.seq.store(seq + 2, std::memory_order_release);
+}
@@ -0,0 +1,257 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * stats.cpp
+ *
+ * Counters for filesystem calls and the cliex::sys wrappers.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include <string>
+
+#include <vector>
+#include <array>
+
+#include <algorithm>
+
+#include <chrono>
+#include <mutex>
+
+#include <experimental/filesystem>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <ncurses.h>
+
+#include "stats.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+struct counter
+{
+    unsigned long long calls = 0;
+    long long ns = 0;
+};
+
+using counters = std::array<counter, cliex::stats::CALL_COUNT>;
+
+std::mutex mtx;
+std::vector<std::pair<std::string, counters>> actions{{"startup", counters{}}};
+size_t current = 0;
+counters last{};
+
+cliex::stats::footprint mem;
+
+const auto process_start = std::chrono::steady_clock::now();
+std::vector<std::pair<std::string, long long>> phases;
+
+void draw_line(WINDOW *win, int y, const std::string &text)
+{
+    wmove(win, y, 3);
+    wclrtoeol(win);
+    mvwaddstr(win, y, 3, text.c_str());
+}
+
+std::string kb(size_t bytes)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << bytes / 1024.0 << " KB";
+    return out.str();
+}
+}
+
+const char *cliex::stats::call_name(call c)
+{
+    static const char *names[CALL_COUNT] =
+    {
+        "status", "symlink_status", "dir_open", "dir_read",
+        "file_size", "last_write_time", "open", "read",
+        "owner", "name_lookup"
+    };
+    return names[c];
+}
+
+void cliex::stats::begin_action(const char *name)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto it = std::find_if(actions.begin(), actions.end(), [name](const std::pair<std::string, counters> &a)
+    {
+        return a.first == name;
+    });
+    if (it == actions.end())
+        it = actions.emplace(actions.end(), name, counters{});
+
+    current = it - actions.begin();
+    last = counters{};
+}
+
+void cliex::stats::record(call c, long long ns)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    auto &a = actions[current].second[c];
+    a.calls++;
+    a.ns += ns;
+    last[c].calls++;
+    last[c].ns += ns;
+}
+
+void cliex::stats::draw_overlay(WINDOW *win, int starty)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    int maxy = getmaxy(win) - 1;
+    int y = starty;
+    if (y >= maxy)
+        return;
+
+    draw_line(win, y++, "FS calls (" + actions[current].first + "):");
+
+    for (int c = 0; c < CALL_COUNT && y < maxy; c++, y++)
+    {
+        std::ostringstream line;
+        line << std::left << std::setw(16) << call_name(static_cast<call>(c))
+             << std::right << std::setw(6) << last[c].calls
+             << std::setw(10) << std::fixed << std::setprecision(3) << last[c].ns / 1e6 << " ms";
+
+        draw_line(win, y, line.str());
+    }
+
+    if (y < maxy && mem.entries)
+    {
+        auto listing = mem.names + mem.widths + mem.layout;
+        draw_line(win, y++, "Memory: " + std::to_string(listing / mem.entries) + " B/entry, " + std::to_string(mem.entries) + " entries");
+    }
+    if (y < maxy)
+        draw_line(win, y++, "RSS: " + std::to_string(rss_kb() / 1024) + " MB (peak " + std::to_string(peak_rss_kb() / 1024) + " MB)");
+
+    box(win, 0, 0);
+}
+
+void cliex::stats::mark_phase(const char *name)
+{
+    auto elapsed = std::chrono::steady_clock::now() - process_start;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    phases.emplace_back(name, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void cliex::stats::set_footprint(const footprint &f)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    mem = f;
+}
+
+long cliex::stats::rss_kb()
+{
+    long pages = 0, resident = 0;
+    std::ifstream statm{"/proc/self/statm"};
+    statm >> pages >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+long cliex::stats::peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+std::string cliex::stats::dump()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::ostringstream out;
+
+    out << std::left << std::setw(12) << "action" << std::setw(16) << "call"
+        << std::right << std::setw(10) << "count" << std::setw(14) << "total ms" << std::setw(12) << "avg us" << "\n";
+
+    counters total{};
+    for (const auto &a : actions)
+    {
+        for (int c = 0; c < CALL_COUNT; c++)
+        {
+            const auto &k = a.second[c];
+            total[c].calls += k.calls;
+            total[c].ns += k.ns;
+            if (!k.calls)
+                continue;
+
+            out << std::left << std::setw(12) << a.first << std::setw(16) << call_name(static_cast<call>(c))
+                << std::right << std::setw(10) << k.calls
+                << std::setw(14) << std::fixed << std::setprecision(3) << k.ns / 1e6
+                << std::setw(12) << std::setprecision(2) << k.ns / 1e3 / k.calls << "\n";
+        }
+    }
+
+    for (int c = 0; c < CALL_COUNT; c++)
+    {
+        const auto &k = total[c];
+        if (!k.calls)
+            continue;
+
+        out << std::left << std::setw(12) << "total" << std::setw(16) << call_name(static_cast<call>(c))
+            << std::right << std::setw(10) << k.calls
+            << std::setw(14) << std::fixed << std::setprecision(3) << k.ns / 1e6
+            << std::setw(12) << std::setprecision(2) << k.ns / 1e3 / k.calls << "\n";
+    }
+
+    out << "\nstartup phases (ms since start):\n";
+    for (const auto &p : phases)
+        out << "  " << std::left << std::setw(12) << p.first << std::right << std::setw(12) << std::setprecision(3) << p.second / 1e6 << "\n";
+
+    out << "\nmemory of the last listing (" << mem.entries << " entries):\n";
+    std::pair<const char *, size_t> parts[] =
+    {
+        {"names", mem.names}, {"widths", mem.widths}, {"layout", mem.layout}, {"types", mem.types}
+    };
+    for (const auto &p : parts)
+    {
+        out << "  " << std::left << std::setw(10) << p.first << std::right << std::setw(14) << kb(p.second);
+        if (mem.entries)
+            out << std::setw(10) << std::setprecision(1) << static_cast<double>(p.second) / mem.entries << " B/entry";
+        out << "\n";
+    }
+    out << "  " << std::left << std::setw(10) << "peak rss" << std::right << std::setw(14) << kb(peak_rss_kb() * 1024) << "\n";
+    return out.str();
+}
+
+fs::file_status cliex::sys::status(const fs::path &p)
+{
+    stats::timer t{stats::CALL_STATUS};
+    return fs::status(p);
+}
+
+std::fstream cliex::sys::open(const fs::path &p, std::ios::openmode mode)
+{
+    stats::timer t{stats::CALL_OPEN};
+    return std::fstream{p, mode};
+}
+
+bool cliex::sys::read_line(std::istream &in, std::string &line)
+{
+    stats::timer t{stats::CALL_READ};
+    return static_cast<bool>(std::getline(in, line));
+}
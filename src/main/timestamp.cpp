@@ -0,0 +1,252 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+
+/**
+ * timestamp.cpp
+ *
+ * A span is found by galloping away from the first time that needed it
+ * until the offset differs, then bisecting to the second; steps stay short
+ * enough not to jump over two changes at once. That takes a few dozen
+ * lookups, so spans are only searched for with lookups saved earlier: every
+ * time formatted earns one, what libc would have spent on it, and a miss
+ * without enough of them asks libc once. Times scattered over more spans
+ * than are kept cost no more lookups than libc then. Dates come from the
+ * day number with the usual civil calendar arithmetic.
+*/
+
+#include <string>
+#include <stdexcept>
+
+#include <algorithm>
+
+#include <time.h>
+
+#include "timestamp.hpp"
+
+namespace
+{
+struct span
+{
+    long long lo = 0;
+    long long hi = 0;
+    long offset = 0;
+};
+
+thread_local span spans[TIMESTAMP_SPANS];
+thread_local unsigned next_span = 0;
+// lookups that may still go into finding spans
+thread_local long long credit = TIMESTAMP_SEARCH_COST;
+
+long gmtoff(long long t)
+{
+    credit--;
+    time_t tt = t;
+    struct tm tm;
+    if (!localtime_r(&tt, &tm))
+        return 0;
+    return tm.tm_gmtoff;
+}
+
+// the furthest second from t towards dir that still has the offset, at
+// most a year away
+long long edge(long long t, long offset, int dir)
+{
+    const long long max_step = 16 * 86400LL;
+    const long long limit = 366 * 86400LL;
+
+    long long same = t;
+    long long step = 3600;
+    for (long long dist = step; dist <= limit; dist += step)
+    {
+        long long probe = t + dir * dist;
+        if (gmtoff(probe) != offset)
+        {
+            long long differs = probe;
+            while (differs - same > 1 || same - differs > 1)
+            {
+                long long mid = same + (differs - same) / 2;
+                if (gmtoff(mid) == offset)
+                    same = mid;
+                else
+                    differs = mid;
+            }
+            return same;
+        }
+        same = probe;
+        step = std::min(step * 2, max_step);
+    }
+    return same;
+}
+
+long offset_at(long long t)
+{
+    credit++;
+    for (const auto &s : spans)
+    {
+        if (t >= s.lo && t < s.hi)
+            return s.offset;
+    }
+
+    if (credit < TIMESTAMP_SEARCH_COST)
+        return gmtoff(t);
+
+    auto &s = spans[next_span++ % TIMESTAMP_SPANS];
+    s.offset = gmtoff(t);
+    s.lo = edge(t, s.offset, -1);
+    s.hi = edge(t, s.offset, 1) + 1;
+    return s.offset;
+}
+
+long long floor_div(long long a, long long b)
+{
+    return a / b - (a % b < 0);
+}
+
+struct local_time
+{
+    long long day;
+    int year;
+    unsigned month, mday, hour, minute, second;
+};
+
+local_time to_local(long long t)
+{
+    local_time l;
+    long long secs = t + offset_at(t);
+    l.day = floor_div(secs, 86400);
+    long long in_day = secs - l.day * 86400;
+    l.hour = in_day / 3600;
+    l.minute = in_day / 60 % 60;
+    l.second = in_day % 60;
+
+    // days since 1970-01-01 to a date, in eras of 400 years from 0000-03-01
+    long long z = l.day + 719468;
+    long long era = floor_div(z, 146097);
+    unsigned doe = z - era * 146097;
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    l.mday = doy - (153 * mp + 2) / 5 + 1;
+    l.month = mp < 10 ? mp + 3 : mp - 9;
+    l.year = yoe + era * 400 + (l.month <= 2);
+    return l;
+}
+
+char *put(char *p, unsigned long long n, int width)
+{
+    char digits[20];
+    int len = 0;
+    do
+    {
+        digits[len++] = '0' + n % 10;
+        n /= 10;
+    }
+    while (n);
+
+    for (int i = len; i < width; i++)
+        *p++ = '0';
+    while (len)
+        *p++ = digits[--len];
+    return p;
+}
+
+char *put(char *p, const char *s)
+{
+    while (*s)
+        *p++ = *s++;
+    return p;
+}
+
+char *put_date(char *p, const local_time &l)
+{
+    if (l.year < 0)
+        *p++ = '-';
+    p = put(p, l.year < 0 ? -l.year : l.year, 4);
+    *p++ = '-';
+    p = put(p, l.month, 2);
+    *p++ = '-';
+    return put(p, l.mday, 2);
+}
+
+char *put_clock(char *p, const local_time &l)
+{
+    p = put(p, l.hour, 2);
+    *p++ = ':';
+    return put(p, l.minute, 2);
+}
+}
+
+cliex::timestamp::style cliex::timestamp::parse_style(const std::string &s)
+{
+    if (s.empty() || s == "iso")
+        return STYLE_ISO;
+    if (s == "relative")
+        return STYLE_RELATIVE;
+    throw std::invalid_argument("unknown time style " + s + ", use iso or relative");
+}
+
+size_t cliex::timestamp::format(long long t, style s, char *buf, long long now)
+{
+    char *p = buf;
+    auto l = to_local(t);
+    long long age = now - t;
+
+    if (s == STYLE_RELATIVE && age >= 0)
+    {
+        long long days = to_local(now).day - l.day;
+        if (age < 60)
+        {
+            p = put(p, "just now");
+        }
+        else if (age < 3600)
+        {
+            p = put(p, age / 60, 1);
+            p = put(p, " min ago");
+        }
+        else if (days <= 1)
+        {
+            p = put(p, days ? "yesterday " : "today ");
+            p = put_clock(p, l);
+        }
+        else if (days < 7)
+        {
+            p = put(p, days, 1);
+            p = put(p, " days ago");
+        }
+        else
+        {
+            p = put_date(p, l);
+        }
+        *p = '\0';
+        return p - buf;
+    }
+
+    p = put_date(p, l);
+    *p++ = ' ';
+    p = put_clock(p, l);
+    *p++ = ':';
+    p = put(p, l.second, 2);
+    *p = '\0';
+    return p - buf;
+}
+
+size_t cliex::timestamp::format(long long t, style s, char *buf)
+{
+    return format(t, s, buf, time(nullptr));
+}
@@ -0,0 +1,372 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * tree.cpp
+ *
+ * An expanded node is always the last entry of its segment, followed by the
+ * segments of its children and then by the rest of its own listing. Child
+ * listings skip their "..", which entry_less puts first.
+*/
+
+#include <string>
+#include <vector>
+
+#include <algorithm>
+#include <memory>
+
+#include <ncurses.h>
+
+#include "tree.hpp"
+#include "cache.hpp"
+#include "grid.hpp"
+#include "frame.hpp"
+#include "width.hpp"
+
+static size_t first_child(const cliex::listing &l)
+{
+    return !l.entries.empty() && l.entries[0] == ".." ? 1 : 0;
+}
+
+cliex::tree_view::~tree_view()
+{
+    close();
+}
+
+void cliex::tree_view::place(WINDOW *parent, int height, int width, int starty, int startx)
+{
+    close();
+    win = derwin(parent, height, width, starty, startx);
+}
+
+void cliex::tree_view::close()
+{
+    if (win)
+    {
+        frame::forget(win);
+        delwin(win);
+    }
+    win = nullptr;
+}
+
+void cliex::tree_view::assign(std::shared_ptr<listing> l)
+{
+    size_t n = l->entries.size();
+    segments.assign(1, {std::move(l), 0, n, 0, false});
+    starts.assign(1, 0);
+    current = top = 0;
+}
+
+void cliex::tree_view::reflow()
+{
+    top = 0;
+    move_to(current);
+}
+
+size_t cliex::tree_view::rows() const
+{
+    return segments.empty() ? 0 : starts.back() + segments.back().last - segments.back().first;
+}
+
+size_t cliex::tree_view::locate(size_t row) const
+{
+    return std::upper_bound(starts.begin(), starts.end(), row) - starts.begin() - 1;
+}
+
+bool cliex::tree_view::expanded(size_t s) const
+{
+    return s + 1 < segments.size() && segments[s + 1].depth > segments[s].depth;
+}
+
+void cliex::tree_view::restart(size_t from)
+{
+    starts.resize(segments.size());
+    for (size_t s = std::max<size_t>(from, 1); s < segments.size(); s++)
+        starts[s] = starts[s - 1] + segments[s - 1].last - segments[s - 1].first;
+}
+
+// the node at the end of segment s
+void cliex::tree_view::remove_children(size_t s)
+{
+    size_t end = s + 1;
+    while (end < segments.size() && segments[end].depth > segments[s].depth)
+        end++;
+
+    // the rest of the node's own listing joins its segment again
+    if (end < segments.size() && segments[end].shown == segments[s].shown && segments[end].depth == segments[s].depth)
+        segments[s].last = segments[end++].last;
+
+    segments.erase(segments.begin() + s + 1, segments.begin() + end);
+}
+
+void cliex::tree_view::expand(const std::vector<std::string> &opts)
+{
+    if (!rows())
+        return;
+
+    size_t s = locate(current);
+    segment seg = segments[s];
+    size_t i = seg.first + current - starts[s];
+    const auto &name = seg.shown->entries[i];
+    if (name == ".." || name.back() != '/' || (i == seg.last - 1 && expanded(s)))
+        return;
+
+    auto child = cache::get(seg.shown->dir / name.substr(0, name.size() - 1), opts);
+    size_t first = first_child(*child);
+    segment kid{child, first, child->done ? child->entries.size() : first, seg.depth + 1, !child->done};
+
+    segment tail = seg;
+    tail.first = i + 1;
+    segments[s].last = i + 1;
+    segments.insert(segments.begin() + s + 1, {std::move(kid), std::move(tail)});
+    restart(s + 1);
+}
+
+void cliex::tree_view::collapse()
+{
+    if (!rows())
+        return;
+
+    size_t s = locate(current);
+    size_t i = segments[s].first + current - starts[s];
+    if (i == segments[s].last - 1 && expanded(s))
+    {
+        remove_children(s);
+        restart(s + 1);
+        return;
+    }
+
+    // the parent ends the closest segment above that is less deep
+    size_t p = s;
+    while (p > 0 && segments[p].depth >= segments[s].depth)
+        p--;
+    if (segments[p].depth < segments[s].depth)
+        move_to(starts[p] + segments[p].last - segments[p].first - 1);
+}
+
+bool cliex::tree_view::update()
+{
+    bool filled = false;
+    for (size_t s = 0; s < segments.size(); s++)
+    {
+        auto &seg = segments[s];
+        if (!seg.loading || !seg.shown->done)
+            continue;
+
+        seg.loading = false;
+        seg.first = first_child(*seg.shown);
+        seg.last = std::max(seg.first, seg.shown->entries.size());
+
+        if (current >= starts[s])
+            current += seg.last - seg.first;
+        restart(s + 1);
+        filled = true;
+    }
+
+    if (filled)
+        move_to(current);
+    return filled;
+}
+
+bool cliex::tree_view::changed(const listing &l, size_t index, bool inserted)
+{
+    std::vector<size_t> pieces;
+    for (size_t s = 0; s < segments.size(); s++)
+    {
+        if (segments[s].shown.get() == &l && !segments[s].loading)
+            pieces.push_back(s);
+    }
+    if (pieces.empty())
+        return false;
+
+    // the piece the entry is in; a new entry at the very end belongs to the
+    // last piece
+    size_t target = pieces.size();
+    for (size_t k = 0; k < pieces.size(); k++)
+    {
+        const auto &p = segments[pieces[k]];
+        if (p.first <= index && index < p.last)
+        {
+            target = k;
+            break;
+        }
+    }
+    if (inserted && target == pieces.size() && index == segments[pieces.back()].last)
+        target = pieces.size() - 1;
+
+    size_t old_rows = rows();
+    size_t row = 0;
+    bool visible = target < pieces.size();
+    size_t from = pieces.front();
+    if (visible)
+    {
+        size_t s = pieces[target];
+        row = starts[s] + index - segments[s].first;
+        from = s;
+
+        if (!inserted && index == segments[s].last - 1 && expanded(s))
+        {
+            // the pieces after the node's subtree are merged into this one
+            remove_children(s);
+            pieces.clear();
+            for (size_t t = s; t < segments.size(); t++)
+            {
+                if (segments[t].shown.get() == &l && !segments[t].loading)
+                    pieces.push_back(t);
+            }
+            target = 0;
+        }
+    }
+
+    // the pieces behind the entry move along
+    for (size_t k = 0; k < pieces.size(); k++)
+    {
+        auto &p = segments[pieces[k]];
+        if (k == target)
+        {
+            p.last = inserted ? p.last + 1 : p.last - 1;
+        }
+        else if (visible ? k > target : p.first > index || (inserted && p.first == index))
+        {
+            p.first = inserted ? p.first + 1 : p.first - 1;
+            p.last = inserted ? p.last + 1 : p.last - 1;
+        }
+    }
+    restart(from + 1);
+
+    if (visible && current >= row)
+    {
+        size_t removed = old_rows - std::min(old_rows, rows());
+        if (inserted)
+            current++;
+        else
+            current = current >= row + removed ? current - removed : row;
+    }
+    move_to(current);
+    return true;
+}
+
+void cliex::tree_view::move_to(size_t row)
+{
+    size_t total = rows();
+    if (!total)
+    {
+        current = top = 0;
+        return;
+    }
+
+    current = std::min(row, total - 1);
+    size_t height = getmaxy(win);
+    if (current < top)
+        top = current;
+    else if (current >= top + height)
+        top = current - height + 1;
+}
+
+void cliex::tree_view::down()
+{
+    move_to(current + 1);
+}
+
+void cliex::tree_view::up()
+{
+    if (current > 0)
+        move_to(current - 1);
+}
+
+void cliex::tree_view::page_down()
+{
+    move_to(current + getmaxy(win));
+}
+
+void cliex::tree_view::page_up()
+{
+    size_t height = getmaxy(win);
+    move_to(current > height ? current - height : 0);
+}
+
+std::string cliex::tree_view::selected() const
+{
+    if (!rows())
+        return "";
+
+    size_t s = locate(current);
+    return segments[s].shown->entries[segments[s].first + current - starts[s]];
+}
+
+fs::path cliex::tree_view::selected_dir() const
+{
+    return segments.empty() ? fs::path() : segments[locate(current)].shown->dir;
+}
+
+void cliex::tree_view::draw()
+{
+    werase(win);
+
+    size_t total = rows();
+    size_t height = getmaxy(win);
+    unsigned width = getmaxx(win);
+    size_t s = total ? locate(top) : 0;
+    for (size_t r = top; r < std::min(total, top + height); r++)
+    {
+        while (r >= starts[s] + segments[s].last - segments[s].first)
+            s++;
+
+        const auto &seg = segments[s];
+        size_t i = seg.first + r - starts[s];
+        const auto &name = seg.shown->entries[i];
+        unsigned name_width = seg.shown->widths[i];
+        unsigned x = seg.depth * TREE_INDENT;
+        if (x + 2 >= width)
+            continue;
+
+        // + collapsed, - expanded, ~ still loading
+        char mark = ' ';
+        if (name != ".." && name.back() == '/')
+            mark = i == seg.last - 1 && expanded(s) ? (segments[s + 1].loading ? '~' : '-') : '+';
+
+        char extra = mark_of ? mark_of(*seg.shown, i) : 0;
+        unsigned prefix = extra ? 3 : 2;
+        if (x + prefix >= width)
+            continue;
+
+        if (r == current)
+            wattron(win, A_REVERSE);
+
+        mvwaddch(win, r - top, x, mark);
+        if (extra)
+            waddch(win, extra);
+        waddch(win, ' ');
+        unsigned room = width - x - prefix;
+        if (name_width <= room)
+        {
+            waddstr(win, name.c_str());
+            if (r == current)
+                whline(win, ' ', room - name_width);
+        }
+        else
+        {
+            waddnstr(win, name.c_str(), display_prefix(name, room - 1));
+            waddch(win, GRID_TRUNCATED);
+        }
+
+        if (r == current)
+            wattroff(win, A_REVERSE);
+    }
+    frame::touch(win);
+}
@@ -0,0 +1,368 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * vfs.cpp
+ *
+ * The local, in-memory and latency-injecting filesystem backends.
+*/
+
+#include <string>
+
+#include <vector>
+#include <unordered_map>
+
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <system_error>
+
+#include <experimental/filesystem>
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cliex.hpp"
+#include "vfs.hpp"
+#include "stats.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+const char *synthetic_exts[] = {".txt", ".log", ".png", ".cfg", ""};
+
+// every call made through get_vfs() ends up here first, so the accounting
+// includes whatever latency the backend adds
+class accounted_vfs : public cliex::vfs
+{
+public:
+    std::unique_ptr<cliex::vfs> inner{new cliex::local_vfs};
+
+    fs::file_status status(const fs::path &p) override
+    {
+        cliex::stats::timer t{cliex::stats::CALL_STATUS};
+        return inner->status(p);
+    }
+
+    fs::file_status symlink_status(const fs::path &p) override
+    {
+        cliex::stats::timer t{cliex::stats::CALL_SYMLINK_STATUS};
+        return inner->symlink_status(p);
+    }
+
+    // the time spent in the callback is left out, it's accounted for by
+    // whatever the callback calls
+    void list_dir(const fs::path &p, const std::function<void(const std::string&)> &f) override
+    {
+        cliex::stats::timer t{cliex::stats::CALL_DIR_OPEN};
+        inner->list_dir(p, [&f, &t](const std::string &name)
+        {
+            auto start = std::chrono::steady_clock::now();
+            f(name);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+
+            t.start += elapsed;
+            cliex::stats::record(cliex::stats::CALL_DIR_READ, 0);
+        });
+    }
+
+    std::uintmax_t file_size(const fs::path &p) override
+    {
+        cliex::stats::timer t{cliex::stats::CALL_FILE_SIZE};
+        return inner->file_size(p);
+    }
+
+    fs::file_time_type last_write_time(const fs::path &p) override
+    {
+        cliex::stats::timer t{cliex::stats::CALL_LAST_WRITE_TIME};
+        return inner->last_write_time(p);
+    }
+
+    cliex::ownership owner(const fs::path &p) override
+    {
+        cliex::stats::timer t{cliex::stats::CALL_OWNER};
+        return inner->owner(p);
+    }
+
+    bool native() override
+    {
+        return inner->native();
+    }
+};
+
+accounted_vfs root;
+}
+
+cliex::vfs &cliex::get_vfs()
+{
+    return root;
+}
+
+void cliex::set_vfs(std::unique_ptr<vfs> v)
+{
+    root.inner = std::move(v);
+}
+
+fs::file_status cliex::local_vfs::status(const fs::path &p)
+{
+    return fs::status(p);
+}
+
+fs::file_status cliex::local_vfs::symlink_status(const fs::path &p)
+{
+    return fs::symlink_status(p);
+}
+
+void cliex::local_vfs::list_dir(const fs::path &p, const std::function<void(const std::string&)> &f)
+{
+    for (const auto &e : fs::directory_iterator(p))
+        f(e.path().filename().string());
+}
+
+std::uintmax_t cliex::local_vfs::file_size(const fs::path &p)
+{
+    return fs::file_size(p);
+}
+
+fs::file_time_type cliex::local_vfs::last_write_time(const fs::path &p)
+{
+    return fs::last_write_time(p);
+}
+
+cliex::ownership cliex::local_vfs::owner(const fs::path &p)
+{
+    struct stat st;
+    if (stat(p.c_str(), &st))
+        throw fs::filesystem_error("cannot get the owner", p, std::error_code(errno, std::generic_category()));
+    return {st.st_uid, st.st_gid};
+}
+
+void cliex::memory_vfs::add_node(const fs::path &p, node n)
+{
+    auto key = p.string();
+    if (nodes.count(key))
+        return;
+
+    if (p.has_parent_path() && p.parent_path() != p)
+    {
+        add_dir(p.parent_path());
+        nodes[p.parent_path().string()].children.push_back(p.filename().string());
+    }
+    nodes.emplace(key, std::move(n));
+}
+
+void cliex::memory_vfs::add_dir(const fs::path &p)
+{
+    add_node(p, {fs::file_type::directory, fs::perms::owner_all | fs::perms::group_read | fs::perms::group_exec | fs::perms::others_read | fs::perms::others_exec, 4096, fs::file_time_type::clock::now(), {}, 0});
+}
+
+void cliex::memory_vfs::add_file(const fs::path &p, std::uintmax_t size)
+{
+    add_node(p, {fs::file_type::regular, fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read | fs::perms::others_read, size, fs::file_time_type::clock::now(), {}, 0});
+}
+
+void cliex::memory_vfs::add_synthetic(const fs::path &p, size_t count)
+{
+    add_dir(p);
+    nodes[p.string()].synthetic = count;
+}
+
+const cliex::memory_vfs::node *cliex::memory_vfs::find(const fs::path &p, node &scratch)
+{
+    std::string key;
+    for (const auto &c : p)
+    {
+        auto part = c.string();
+        if (part == ".." && key.length())
+            key.erase(key.rfind('/'));
+        else if (part != "." && part != "/" && part != "..")
+            key += "/" + part;
+    }
+    if (key.empty())
+        key = ROOT_DIR;
+
+    auto it = nodes.find(key);
+    if (it != nodes.end())
+        return &it->second;
+
+    auto slash = key.rfind('/');
+    if (slash == key.npos)
+        return nullptr;
+
+    auto parent = nodes.find(slash ? key.substr(0, slash) : ROOT_DIR);
+    if (parent == nodes.end() || !parent->second.synthetic)
+        return nullptr;
+
+    auto name = key.substr(slash + 1);
+    bool is_dir = name.compare(0, 3, "dir") == 0;
+    size_t prefix = is_dir ? 3 : 4;
+    if (name.size() <= prefix || (!is_dir && name.compare(0, 4, "file")))
+        return nullptr;
+
+    size_t i;
+    if (sscanf(name.c_str() + prefix, "%7zu", &i) != 1 || i >= parent->second.synthetic)
+        return nullptr;
+
+    char expected[32];
+    if (i % 10 == 0)
+        snprintf(expected, sizeof expected, "dir%07zu", i);
+    else
+        snprintf(expected, sizeof expected, "file%07zu%s", i, synthetic_exts[i % 5]);
+    if (name != expected)
+        return nullptr;
+
+    scratch.type = parent->second.type;
+    scratch.perms = parent->second.perms;
+    scratch.size = parent->second.size;
+    scratch.mtime = fs::file_time_type::clock::from_time_t(1577836800 + i * 60);
+    scratch.synthetic = 0;
+    if (i % 10)
+    {
+        scratch.type = fs::file_type::regular;
+        scratch.perms = fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read | fs::perms::others_read;
+        scratch.size = (i * 7919) % (1 << 20);
+    }
+    return &scratch;
+}
+
+const cliex::memory_vfs::node &cliex::memory_vfs::get(const fs::path &p, node &scratch)
+{
+    auto n = find(p, scratch);
+    if (!n)
+        throw fs::filesystem_error("memory_vfs", p, std::make_error_code(std::errc::no_such_file_or_directory));
+    return *n;
+}
+
+fs::file_status cliex::memory_vfs::status(const fs::path &p)
+{
+    node scratch;
+    auto n = find(p, scratch);
+    return n ? fs::file_status(n->type, n->perms) : fs::file_status(fs::file_type::not_found);
+}
+
+fs::file_status cliex::memory_vfs::symlink_status(const fs::path &p)
+{
+    return status(p);
+}
+
+void cliex::memory_vfs::list_dir(const fs::path &p, const std::function<void(const std::string&)> &f)
+{
+    node scratch;
+    const auto &n = get(p, scratch);
+    if (n.type != fs::file_type::directory)
+        throw fs::filesystem_error("memory_vfs", p, std::make_error_code(std::errc::not_a_directory));
+
+    for (const auto &c : n.children)
+        f(c);
+
+    char name[32];
+    for (size_t i = 0; i < n.synthetic; i++)
+    {
+        if (i % 10 == 0)
+            snprintf(name, sizeof name, "dir%07zu", i);
+        else
+            snprintf(name, sizeof name, "file%07zu%s", i, synthetic_exts[i % 5]);
+        f(name);
+    }
+}
+
+std::uintmax_t cliex::memory_vfs::file_size(const fs::path &p)
+{
+    node scratch;
+    const auto &n = get(p, scratch);
+    if (n.type == fs::file_type::directory)
+        throw fs::filesystem_error("memory_vfs", p, std::make_error_code(std::errc::is_a_directory));
+    return n.size;
+}
+
+fs::file_time_type cliex::memory_vfs::last_write_time(const fs::path &p)
+{
+    node scratch;
+    return get(p, scratch).mtime;
+}
+
+// everything in memory belongs to whoever runs the explorer
+cliex::ownership cliex::memory_vfs::owner(const fs::path &p)
+{
+    node scratch;
+    get(p, scratch);
+    return {getuid(), getgid()};
+}
+
+cliex::latency_vfs::latency_vfs(std::unique_ptr<vfs> v, int latency, int jitter, double failures)
+    : inner(std::move(v)), latency_ms(latency), jitter_ms(jitter), failure_rate(failures)
+{
+}
+
+void cliex::latency_vfs::delay(const fs::path &p)
+{
+    int ms;
+    bool fail;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        ms = latency_ms + (jitter_ms > 0 ? std::uniform_int_distribution<int>(0, jitter_ms)(rng) : 0);
+        fail = failure_rate > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < failure_rate;
+    }
+
+    if (ms > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    if (fail)
+        throw fs::filesystem_error("injected failure", p, std::make_error_code(std::errc::io_error));
+}
+
+fs::file_status cliex::latency_vfs::status(const fs::path &p)
+{
+    delay(p);
+    return inner->status(p);
+}
+
+fs::file_status cliex::latency_vfs::symlink_status(const fs::path &p)
+{
+    delay(p);
+    return inner->symlink_status(p);
+}
+
+void cliex::latency_vfs::list_dir(const fs::path &p, const std::function<void(const std::string&)> &f)
+{
+    delay(p);
+    inner->list_dir(p, f);
+}
+
+std::uintmax_t cliex::latency_vfs::file_size(const fs::path &p)
+{
+    delay(p);
+    return inner->file_size(p);
+}
+
+fs::file_time_type cliex::latency_vfs::last_write_time(const fs::path &p)
+{
+    delay(p);
+    return inner->last_write_time(p);
+}
+
+cliex::ownership cliex::latency_vfs::owner(const fs::path &p)
+{
+    delay(p);
+    return inner->owner(p);
+}
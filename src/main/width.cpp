@@ -0,0 +1,217 @@
+/*
+ * A simple terminal-based file explorer written in C++ using the ncurses lib.
+ * Copyright (C) 2020  Andreas Sünder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>
+*/
+
+/**
+ * width.cpp
+ *
+ * Pure ASCII runs are measured a block at a time. Everything else is decoded
+ * as UTF-8 and looked up in a two-level table: the first level maps a block
+ * of 256 code points to one of the distinct blocks of the second level,
+ * which stores 2 bits per code point. The table is filled from wcwidth on
+ * first use, so it agrees with the C library ncurses uses as well.
+*/
+
+#include <string>
+
+#include <array>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#include <langinfo.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "width.hpp"
+
+// code points above are looked up with wcwidth directly, they're rare
+#define WIDTH_TABLE_LIMIT 0x40000
+#define WIDTH_BLOCK 256
+
+namespace
+{
+struct table
+{
+    bool utf8;
+    std::vector<uint16_t> index;
+    std::vector<std::array<uint8_t, WIDTH_BLOCK / 4>> blocks;
+};
+
+table widths;
+std::once_flag built;
+
+// control characters are drawn as ^X or ~X
+unsigned char_width(wchar_t c)
+{
+    if (c < 0x20 || (c >= 0x7F && c < 0xA0))
+        return 2;
+
+    int w = wcwidth(c);
+    return w < 0 ? 1 : w;
+}
+
+void build()
+{
+    widths.utf8 = !strcmp(nl_langinfo(CODESET), "UTF-8");
+    if (!widths.utf8)
+        return;
+
+    std::map<std::array<uint8_t, WIDTH_BLOCK / 4>, uint16_t> known;
+    for (wchar_t first = 0; first < WIDTH_TABLE_LIMIT; first += WIDTH_BLOCK)
+    {
+        std::array<uint8_t, WIDTH_BLOCK / 4> block{};
+        for (int i = 0; i < WIDTH_BLOCK; i++)
+            block[i / 4] |= char_width(first + i) << (i % 4 * 2);
+
+        auto it = known.find(block);
+        if (it == known.end())
+        {
+            it = known.emplace(block, widths.blocks.size()).first;
+            widths.blocks.push_back(block);
+        }
+        widths.index.push_back(it->second);
+    }
+}
+
+unsigned lookup(uint32_t c)
+{
+    if (c >= WIDTH_TABLE_LIMIT)
+        return char_width(c);
+
+    const auto &block = widths.blocks[widths.index[c / WIDTH_BLOCK]];
+    unsigned i = c % WIDTH_BLOCK;
+    return (block[i / 4] >> (i % 4 * 2)) & 3;
+}
+
+// the length of the printable ASCII prefix
+size_t ascii_prefix(const char *s, size_t n)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    // bytes from 0x80 are negative, so one signed compare finds them and the
+    // control characters
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        __m128i special = _mm_or_si128(_mm_cmplt_epi8(v, space), _mm_cmpeq_epi8(v, del));
+        if (_mm_movemask_epi8(special))
+            break;
+    }
+#else
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = 0x8080808080808080ULL;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, s + i, 8);
+        uint64_t del = w ^ (0x7F * ones);
+        if ((w & high) || ((w - 0x20 * ones) & ~w & high) || ((del - ones) & ~del & high))
+            break;
+    }
+#endif
+    while (i < n && s[i] >= 0x20 && s[i] < 0x7F)
+        i++;
+    return i;
+}
+
+// decodes one character, invalid sequences count as a single byte
+uint32_t decode(const unsigned char *s, size_t n, size_t &len)
+{
+    uint32_t c = s[0];
+    if (c < 0xC2 || c > 0xF4)
+    {
+        len = 1;
+        return c < 0x80 ? c : 0xFFFD;
+    }
+
+    len = c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+    if (len > n)
+    {
+        len = 1;
+        return 0xFFFD;
+    }
+
+    c &= 0x3F >> (len - 1);
+    for (size_t i = 1; i < len; i++)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            len = 1;
+            return 0xFFFD;
+        }
+        c = (c << 6) | (s[i] & 0x3F);
+    }
+    return c;
+}
+}
+
+/*
+ * Walks s until the next character would exceed limit columns. Returns the
+ * number of bytes taken, width is set to their columns.
+*/
+static size_t measure(const char *s, size_t n, size_t limit, size_t &width)
+{
+    width = 0;
+    size_t i = 0;
+    while (i < n)
+    {
+        size_t ascii = std::min(ascii_prefix(s + i, n - i), limit - width);
+        width += ascii;
+        i += ascii;
+        if (i == n || width == limit)
+            break;
+
+        std::call_once(built, build);
+        auto c = reinterpret_cast<const unsigned char *>(s + i);
+        size_t len = 1;
+        size_t w;
+        if (*c < 0x80)
+            w = char_width(*c);
+        else if (!widths.utf8)
+            w = 2 + char_width(*c & 0x7F); // every byte is a character of its own, drawn as M-x
+        else
+            w = lookup(decode(c, n - i, len));
+
+        if (width + w > limit)
+            break;
+        width += w;
+        i += len;
+    }
+    return i;
+}
+
+unsigned cliex::display_width(const char *s, size_t n)
+{
+    size_t width;
+    measure(s, n, SIZE_MAX, width);
+    return width < MAX_DISPLAY_WIDTH ? width : MAX_DISPLAY_WIDTH;
+}
+
+size_t cliex::display_prefix(const std::string &s, unsigned columns)
+{
+    size_t width;
+    return measure(s.data(), s.size(), columns, width);
+}